@@ -0,0 +1,116 @@
+#include "AssetLoader.hpp"
+#include "Geometry.hpp"
+#include "GeometryFormats.hpp"
+#include "jobs/job_system.hpp"
+#include "profiler/scope_profiler.h"
+#include <chrono>
+#include <thread>
+#include <sstream>
+#include <iostream>
+
+AssetLoader::GeometryHandle::GeometryHandle(AssetLoader* loader, const String& fileName) :
+	loader(loader), fileName(fileName), read(false), failed(false) {}
+
+bool AssetLoader::GeometryHandle::IsReady() const
+{
+	return geometry;
+}
+
+bool AssetLoader::GeometryHandle::IsFailed() const
+{
+	return failed;
+}
+
+ptr<Geometry> AssetLoader::GeometryHandle::Get() const
+{
+	return geometry;
+}
+
+AssetLoader::AssetLoader(ptr<FileSystem> fileSystem, ptr<Device> device, ptr<GeometryFormats> geometryFormats, JobSystem* jobs) :
+	fileSystem(fileSystem), device(device), geometryFormats(geometryFormats), jobs(jobs) {}
+
+AssetLoader::~AssetLoader()
+{
+	if(!jobs)
+		return;
+	// the ready queue is fifo, so waiting for a job submitted last runs or lets start every read submitted before
+	Job* barrier = jobs->create([](void*, size_t, size_t) {}, nullptr);
+	jobs->submit(barrier);
+	jobs->wait(barrier);
+	// reads taken by workers may still go on
+	for(size_t i = 0; i < pendingGeometries.size(); ++i)
+		while(!pendingGeometries[i]->read.load(std::memory_order_acquire))
+			std::this_thread::yield();
+}
+
+void AssetLoader::ReadGeometry(void* data, size_t, size_t)
+{
+	SCOPE_PROFILER(AssetRead);
+	GeometryHandle* handle = static_cast<GeometryHandle*>(data);
+	try
+	{
+		handle->verticesFile = handle->loader->fileSystem->LoadFile(handle->fileName + ".vertices");
+		handle->indicesFile = handle->loader->fileSystem->LoadFile(handle->fileName + ".indices");
+	}
+	catch(Exception* exception)
+	{
+		handle->exception = exception;
+	}
+	handle->read.store(true, std::memory_order_release);
+}
+
+ptr<AssetLoader::GeometryHandle> AssetLoader::LoadGeometry(const String& fileName)
+{
+	ptr<GeometryHandle> handle = NEW(GeometryHandle(this, fileName));
+	// the handle is kept alive by the pending list until the job is finished
+	pendingGeometries.push_back(handle);
+	if(jobs)
+		jobs->submit(jobs->create(&AssetLoader::ReadGeometry, (GeometryHandle*)handle));
+	else
+		ReadGeometry((GeometryHandle*)handle, 0, 1);
+	return handle;
+}
+
+void AssetLoader::Update(float timeBudget)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	size_t kept = 0;
+	bool budgetSpent = false;
+	for(size_t i = 0; i < pendingGeometries.size(); ++i)
+	{
+		ptr<GeometryHandle> handle = pendingGeometries[i];
+		if(budgetSpent || !handle->read.load(std::memory_order_acquire))
+		{
+			pendingGeometries[kept++] = handle;
+			continue;
+		}
+
+		if(handle->exception)
+		{
+			handle->failed = true;
+			std::ostringstream s;
+			MakePointer(NEW(Exception("Can't load geometry " + handle->fileName, handle->exception)))->PrintStack(s);
+			std::cout << s.str() << '\n';
+		}
+		else
+		{
+			SCOPE_PROFILER(AssetCreate);
+			handle->geometry = NEW(Geometry(
+				device->CreateStaticVertexBuffer(handle->verticesFile, geometryFormats->debug.vl),
+				device->CreateStaticIndexBuffer(handle->indicesFile, sizeof(short))
+			));
+		}
+		// files are released here, on the main thread
+		handle->verticesFile = nullptr;
+		handle->indicesFile = nullptr;
+		handle->exception = nullptr;
+
+		budgetSpent = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count() >= timeBudget;
+	}
+	pendingGeometries.resize(kept);
+}
+
+size_t AssetLoader::GetPendingCount() const
+{
+	return pendingGeometries.size();
+}
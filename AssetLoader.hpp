@@ -0,0 +1,74 @@
+#ifndef ___FIRSTBLOOD_ASSET_LOADER_HPP___
+#define ___FIRSTBLOOD_ASSET_LOADER_HPP___
+
+#include "general.hpp"
+#include <vector>
+#include <atomic>
+
+class Geometry;
+class GeometryFormats;
+class JobSystem;
+
+// time for creating device resources of loaded assets per frame, in seconds
+#define ASSET_LOADER_FRAME_BUDGET 0.002f
+
+// reads asset files on worker threads, device resources are created on the main thread
+// a few per frame, under a time budget
+// files are read through a file system of the loader's own: refcounts of inanity objects are not atomic,
+// so objects touched by the jobs must not be shared with the main thread
+// without a job system files are read right away on the calling thread, for file systems which only hand out memory
+class AssetLoader : public Object
+{
+public:
+	// geometry becoming available in one of the next frames
+	class GeometryHandle : public Object
+	{
+		friend class AssetLoader;
+	private:
+		AssetLoader* loader;
+		String fileName;
+		// written by the job, the job is done with the handle once read is set
+		// jobs live in a ring and are reused, so the handle doesn't keep them across frames
+		ptr<File> verticesFile;
+		ptr<File> indicesFile;
+		ptr<Exception> exception;
+		std::atomic<bool> read;
+
+		ptr<Geometry> geometry;
+		bool failed;
+
+	public:
+		GeometryHandle(AssetLoader* loader, const String& fileName);
+
+		bool IsReady() const;
+		// the error is printed when the loader gets to the failed asset
+		bool IsFailed() const;
+		// nullptr until ready
+		ptr<Geometry> Get() const;
+	};
+
+private:
+	ptr<FileSystem> fileSystem;
+	ptr<Device> device;
+	ptr<GeometryFormats> geometryFormats;
+	JobSystem* jobs;
+	// in order of requests
+	std::vector<ptr<GeometryHandle> > pendingGeometries;
+
+	static void ReadGeometry(void* data, size_t begin, size_t end);
+
+public:
+	// jobs may be nullptr
+	AssetLoader(ptr<FileSystem> fileSystem, ptr<Device> device, ptr<GeometryFormats> geometryFormats, JobSystem* jobs);
+	// waits for jobs in flight
+	~AssetLoader();
+
+	// .vertices and .indices are read by a single job
+	ptr<GeometryHandle> LoadGeometry(const String& fileName);
+	// creates resources of read assets until the budget is spent, at least one per call
+	void Update(float timeBudget);
+	// requested assets not ready or failed yet
+	size_t GetPendingCount() const;
+};
+
+#endif
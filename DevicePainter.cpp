@@ -0,0 +1,380 @@
+#include "DevicePainter.hpp"
+#include "Geometry.hpp"
+
+//*** DevicePainter
+
+const int DevicePainter::shadowMapSize = 512;
+
+DevicePainter::DebugAttributes::DebugAttributes(ptr<Device> device, ptr<GeometryFormats> geometryFormats) :
+	ab(device->CreateAttributeBinding(geometryFormats->debug.al)),
+	position(geometryFormats->debug.alePosition),
+	color(geometryFormats->debug.aleColor)
+{}
+
+DevicePainter::ShadowSceneUniforms::ShadowSceneUniforms(ptr<Device> device) :
+	group(NEW(UniformGroup(0))),
+	viewProjTransform(group->AddUniform<mat4x4>())
+{
+	group->Finalize(device);
+}
+
+DevicePainter::ShadowBlurUniforms::ShadowBlurUniforms(ptr<Device> device) :
+	group(NEW(UniformGroup(0))),
+	sourceSampler(0),
+	blurDirection(group->AddUniform<vec2>())
+{
+	group->Finalize(device);
+}
+
+DevicePainter::DevicePainter(ptr<Device> device, ptr<Context> context, ptr<Presenter> presenter, ptr<Output> output, ptr<ShaderCache> shaderCache, ptr<GeometryFormats> geometryFormats) :
+	device(device),
+	context(context),
+	presenter(presenter),
+	output(output),
+	screenWidth(0), screenHeight(0),
+	shaderCache(shaderCache),
+	geometryFormats(geometryFormats),
+
+	debugAttributes(device, geometryFormats),
+	shadowSceneUniforms(device),
+	shadowBlurUniforms(device),
+
+	iTexcoord(0),
+	iColor(1),
+	iDepth(2)
+{
+	// группы общих uniform'ов размечены в Painter, буферы им создаются здесь
+	skyUniforms.group->Finalize(device);
+	colorSceneUniforms.group->Finalize(device);
+	toneUniforms.group->Finalize(device);
+
+	// создать ресурсы, зависящие от размера экрана
+	ResizeScreen(output->GetWidth(), output->GetHeight());
+
+	rbShadow = device->CreateRenderBuffer(shadowMapSize, shadowMapSize, PixelFormats::floatR16);
+	dsbShadow = device->CreateDepthStencilBuffer(shadowMapSize, shadowMapSize, false);
+	fbShadow = device->CreateFrameBuffer();
+	fbShadow->SetColorBuffer(0, rbShadow);
+	fbShadow->SetDepthStencilBuffer(dsbShadow);
+	rbShadowBlur = device->CreateRenderBuffer(shadowMapSize, shadowMapSize, PixelFormats::floatR16);
+
+	// геометрия полноэкранного прохода
+	struct Quad
+	{
+		// вершина для фильтра
+		struct Vertex
+		{
+			vec4 position;
+			vec2 texcoord;
+			vec2 gap;
+		};
+
+		ptr<VertexLayout> vl;
+		ptr<AttributeLayout> al;
+		ptr<AttributeLayoutSlot> als;
+		Value<vec4> aPosition;
+		Value<vec2> aTexcoord;
+
+		ptr<VertexBuffer> vb;
+		ptr<IndexBuffer> ib;
+
+		ptr<AttributeBinding> ab;
+
+		Quad(ptr<Device> device) :
+			vl(NEW(VertexLayout(sizeof(Vertex)))),
+			al(NEW(AttributeLayout())),
+			als(al->AddSlot()),
+			aPosition(al->AddElement(als, vl->AddElement(&Vertex::position))),
+			aTexcoord(al->AddElement(als, vl->AddElement(&Vertex::texcoord)))
+		{
+			// разметка геометрии
+			// геометрия полноэкранного квадрата
+			Vertex vertices[] =
+			{
+				{ vec4(-1, -1, 0, 1), vec2(0, 1) },
+				{ vec4(1, -1, 0, 1), vec2(1, 1) },
+				{ vec4(1, 1, 0, 1), vec2(1, 0) },
+				{ vec4(-1, 1, 0, 1), vec2(0, 0) }
+			};
+			unsigned short indices[] = { 0, 2, 1, 0, 3, 2 };
+
+			vb = device->CreateStaticVertexBuffer(MemoryFile::CreateViaCopy(vertices, sizeof(vertices)), vl);
+			ib = device->CreateStaticIndexBuffer(MemoryFile::CreateViaCopy(indices, sizeof(indices)), sizeof(unsigned short));
+
+			ab = device->CreateAttributeBinding(al);
+		}
+	} quad(device);
+
+	//** шейдеры
+
+	Temp<vec4> tmpPosition;
+	vsDebug = shaderCache->GetVertexShader((
+		tmpPosition = mul(colorSceneUniforms.viewProjTransform, newvec4(debugAttributes.position, 1.0f)),
+		//tmpPosition = newvec4(debugAttributes.position, 1.0f),
+		setPosition(tmpPosition),
+		iColor = debugAttributes.color
+		));
+	psDebug = shaderCache->GetPixelShader((
+		fragment(0, newvec4(iColor, 1))
+		));
+
+	//** шейдеры постпроцессинга и размытия теней
+	{
+		abFilter = quad.ab;
+		vbFilter = quad.vb;
+		ibFilter = quad.ib;
+
+		// промежуточные
+		Interpolant<vec2> iTexcoord(0);
+
+		// вершинный шейдер - общий для всех постпроцессингов
+		vsFilter = shaderCache->GetVertexShader((
+			setPosition(quad.aPosition),
+			iTexcoord = screenToTexture(quad.aPosition["xy"])
+			));
+
+		// шейдеры неба
+		vsSky = shaderCache->GetVertexShader((
+			setPosition(newvec4(quad.aPosition["xy"], 1.0f, 1.0f)),
+			iTexcoord = screenToTexture(quad.aPosition["xy"])
+			));
+		Temp<vec4> p;
+		Temp<float> q;
+		psSky = shaderCache->GetPixelShader((
+			p = mul(skyUniforms.invViewProjTransform, newvec4(iTexcoord * newvec2(2.0f, -2.0f) + newvec2(-1.0f, 1.0f), 1.0f, 1.0f)),
+			q = normalize(p["xyz"] / p["w"] - skyUniforms.cameraPosition)["z"] * Value<float>(0.5f) + Value<float>(0.5f),
+			fragment(0, newvec4(q, q, q, 1))
+			));
+
+		// шейдер tone mapping
+		{
+			Temp<vec3> color;
+			Temp<float> luminance, relativeLuminance, intensity;
+			Expression shader = (
+				iTexcoord,
+				color = toneUniforms.sourceSampler.Sample(iTexcoord),
+				fragment(0, newvec4(color, 1.0f))
+#if 0
+				luminance = dot(color, newvec3(0.2126f, 0.7152f, 0.0722f)),
+				relativeLuminance = toneUniforms.luminanceKey * luminance,
+				intensity = relativeLuminance * (Value<float>(1) + relativeLuminance / toneUniforms.maxLuminance) / (Value<float>(1) + relativeLuminance),
+				color = saturate(color * (intensity / luminance)),
+				// гамма-коррекция
+				color = pow(color, newvec3(0.45f, 0.45f, 0.45f)),
+				fragment(0, newvec4(color, 1.0f))
+#endif
+			);
+			psTone = shaderCache->GetPixelShader(shader);
+		}
+
+		// point sampler
+		ssPoint = device->CreateSamplerState();
+		ssPoint->SetFilter(SamplerState::filterPoint, SamplerState::filterPoint, SamplerState::filterPoint);
+		ssPoint->SetWrap(SamplerState::wrapClamp, SamplerState::wrapClamp, SamplerState::wrapClamp);
+		// linear sampler
+		ssLinear = device->CreateSamplerState();
+		ssLinear->SetFilter(SamplerState::filterLinear, SamplerState::filterLinear, SamplerState::filterLinear);
+		ssLinear->SetWrap(SamplerState::wrapClamp, SamplerState::wrapClamp, SamplerState::wrapClamp);
+		// point sampler with border=0
+		ssPointBorder = device->CreateSamplerState();
+		ssPointBorder->SetFilter(SamplerState::filterPoint, SamplerState::filterPoint, SamplerState::filterPoint);
+		ssPointBorder->SetWrap(SamplerState::wrapBorder, SamplerState::wrapBorder, SamplerState::wrapBorder);
+		float borderColor[] = { 0, 0, 0, 0 };
+		ssPointBorder->SetBorderColor(borderColor);
+	}
+
+	vbDebug = device->CreateDynamicVertexBuffer(debugVerticesBufferCount * sizeof(GeometryFormats::Debug::Vertex), geometryFormats->debug.vl);
+	{
+		ptr<File> file = NEW(MemoryFile(debugVerticesBufferCount * sizeof(unsigned short)));
+		unsigned short* indices = (unsigned short*)file->GetData();
+		for(int i = 0; i < debugVerticesBufferCount; ++i)
+			indices[i] = i;
+		ibDebug = device->CreateStaticIndexBuffer(file, sizeof(unsigned short));
+	}
+}
+
+void DevicePainter::ResizeScreen(int screenWidth, int screenHeight)
+{
+	if(screenWidth == this->screenWidth && screenHeight == this->screenHeight)
+		return;
+
+	this->screenWidth = screenWidth;
+	this->screenHeight = screenHeight;
+
+	rbMain = device->CreateRenderBuffer(screenWidth, screenHeight, PixelFormats::floatRGB32);
+	dsbMain = device->CreateDepthStencilBuffer(screenWidth, screenHeight, false);
+	fbMain = device->CreateFrameBuffer();
+	fbMain->SetColorBuffer(0, rbMain);
+	fbMain->SetDepthStencilBuffer(dsbMain);
+	fbPreMain = device->CreateFrameBuffer();
+	fbPreMain->SetColorBuffer(0, rbMain);
+}
+
+Value<vec3> DevicePainter::ApplyQuaternion(Value<vec4> q, Value<vec3> v)
+{
+	return v + cross(q["xyz"], cross(q["xyz"], v) + v * q["w"]) * Value<float>(2);
+}
+
+void DevicePainter::Draw()
+{
+	if(!submittedFrame)
+		return;
+	SubmitCommands(*this);
+}
+
+void DevicePainter::BeginPass(PassTarget target)
+{
+	switch(target)
+	{
+	case targetPreMain:
+		pass.frameBuffer = fbPreMain;
+		break;
+	case targetMain:
+		pass.frameBuffer = fbMain;
+		break;
+	case targetPresenter:
+		pass.frameBuffer = presenter->GetFrameBuffer();
+		break;
+	}
+	// состояние контекста по умолчанию
+	pass.cullMode = Context::cullModeBack;
+	pass.depthTestFunc = Context::depthTestFuncLess;
+	pass.depthWrite = true;
+	pass.uniforms = nullptr;
+	pass.vertexShader = nullptr;
+	pass.pixelShader = nullptr;
+	pass.vertexBuffer = nullptr;
+	pass.indexBuffer = nullptr;
+	pass.attributeBinding = nullptr;
+	pass.mainSource = false;
+}
+
+void DevicePainter::EndPass()
+{
+	pass.frameBuffer = nullptr;
+}
+
+void DevicePainter::ClearColor(const vec4& color)
+{
+	Context::LetFrameBuffer lfb(context, pass.frameBuffer);
+	Context::LetViewport lv(context, screenWidth, screenHeight);
+	float clearColor[] = { color.x, color.y, color.z, color.w };
+	context->ClearColor(0, clearColor);
+}
+
+void DevicePainter::ClearDepth(float depth)
+{
+	Context::LetFrameBuffer lfb(context, pass.frameBuffer);
+	Context::LetViewport lv(context, screenWidth, screenHeight);
+	context->ClearDepth(depth);
+}
+
+void DevicePainter::SetCullMode(Context::CullMode cullMode)
+{
+	pass.cullMode = cullMode;
+}
+
+void DevicePainter::SetDepthTestFunc(Context::DepthTestFunc depthTestFunc)
+{
+	pass.depthTestFunc = depthTestFunc;
+}
+
+void DevicePainter::SetDepthWrite(bool depthWrite)
+{
+	pass.depthWrite = depthWrite;
+}
+
+void DevicePainter::SetUniforms(UniformsId uniforms, const Frame& frame)
+{
+	switch(uniforms)
+	{
+	case uniformsSky:
+		skyUniforms.invViewProjTransform.SetValue(frame.cameraInvViewProj);
+		skyUniforms.cameraPosition.SetValue(frame.cameraPosition);
+		pass.uniforms = skyUniforms.group;
+		break;
+	case uniformsColorScene:
+		colorSceneUniforms.viewProjTransform.SetValue(frame.cameraViewProj);
+		colorSceneUniforms.invViewProjTransform.SetValue(frame.cameraInvViewProj);
+		colorSceneUniforms.cameraPosition.SetValue(frame.cameraPosition);
+		colorSceneUniforms.sunTransform.SetValue(frame.sunTransform);
+		colorSceneUniforms.sunLight.SetValue(frame.sunLight);
+		pass.uniforms = colorSceneUniforms.group;
+		break;
+	case uniformsTone:
+		toneUniforms.luminanceKey.SetValue(frame.toneLuminanceKey);
+		toneUniforms.maxLuminance.SetValue(frame.toneMaxLuminance);
+		pass.uniforms = toneUniforms.group;
+		break;
+	}
+	pass.uniforms->Upload(context);
+}
+
+void DevicePainter::SetProgram(ProgramId program)
+{
+	switch(program)
+	{
+	case programSky:
+		pass.vertexShader = vsSky;
+		pass.pixelShader = psSky;
+		break;
+	case programDebug:
+		pass.vertexShader = vsDebug;
+		pass.pixelShader = psDebug;
+		break;
+	case programTone:
+		pass.vertexShader = vsFilter;
+		pass.pixelShader = psTone;
+		break;
+	}
+}
+
+void DevicePainter::SetGeometry(GeometryId geometry)
+{
+	switch(geometry)
+	{
+	case geometryFilter:
+		pass.vertexBuffer = vbFilter;
+		pass.indexBuffer = ibFilter;
+		pass.attributeBinding = abFilter;
+		break;
+	case geometryDebug:
+		pass.vertexBuffer = vbDebug;
+		pass.indexBuffer = ibDebug;
+		pass.attributeBinding = debugAttributes.ab;
+		break;
+	}
+}
+
+void DevicePainter::SetMainSource()
+{
+	pass.mainSource = true;
+}
+
+void DevicePainter::UploadDebugVertices(const GeometryFormats::Debug::Vertex* vertices, int count)
+{
+	context->UploadVertexBufferData(vbDebug, vertices, count * sizeof(GeometryFormats::Debug::Vertex));
+}
+
+void DevicePainter::DrawCall(int indicesCount)
+{
+	Context::LetFrameBuffer lfb(context, pass.frameBuffer);
+	Context::LetViewport lv(context, screenWidth, screenHeight);
+	Context::LetCullMode lcm(context, pass.cullMode);
+	Context::LetDepthTestFunc ldtf(context, pass.depthTestFunc);
+	Context::LetDepthWrite ldw(context, pass.depthWrite);
+	Context::LetUniformBuffer lub(context, pass.uniforms);
+	Context::LetVertexShader lvs(context, pass.vertexShader);
+	Context::LetPixelShader lps(context, pass.pixelShader);
+	Context::LetVertexBuffer lvb(context, 0, pass.vertexBuffer);
+	Context::LetIndexBuffer lib(context, pass.indexBuffer);
+	Context::LetAttributeBinding lab(context, pass.attributeBinding);
+	// контекст запоминает установленное, так что повторная установка того же состояния ничего не стоит
+	if(pass.mainSource)
+	{
+		Context::LetSampler lsSource(context, toneUniforms.sourceSampler, rbMain->GetTexture(), ssPoint);
+		context->Draw(indicesCount);
+	}
+	else
+		context->Draw(indicesCount);
+}
@@ -0,0 +1,148 @@
+#ifndef ___FIRSTBLOOD_DEVICE_PAINTER_HPP___
+#define ___FIRSTBLOOD_DEVICE_PAINTER_HPP___
+
+#include "Painter.hpp"
+
+class Geometry;
+
+/// Рисователь мира на графическом устройстве.
+/** Команды кадра, выданные SubmitCommands, сразу отдаются контексту. */
+class DevicePainter : public Painter, private Painter::CommandSink
+{
+private:
+	/// Размер карты теней.
+	static const int shadowMapSize;
+
+	ptr<Device> device;
+	ptr<Context> context;
+	ptr<Presenter> presenter;
+	ptr<Output> output;
+	//** Размер экрана.
+	/** Получается из Output на каждом кадре. */
+	int screenWidth, screenHeight;
+	/// Кэш бинарных шейдеров.
+	ptr<ShaderCache> shaderCache;
+	/// Форматы геометрии.
+	ptr<GeometryFormats> geometryFormats;
+
+	/// Основной буфер кадра.
+	ptr<RenderBuffer> rbMain;
+	/// Основная карта глубины.
+	ptr<DepthStencilBuffer> dsbMain;
+	/// Карта теней.
+	ptr<RenderBuffer> rbShadow;
+	/// Карта глубины для теней.
+	ptr<DepthStencilBuffer> dsbShadow;
+	/// Вспомогательный буфер для размытия тени.
+	ptr<RenderBuffer> rbShadowBlur;
+
+	//*** Фреймбуферы.
+	ptr<FrameBuffer> fbMain, fbPreMain, fbShadow;
+	ptr<FrameBuffer> fbShadowBlur1, fbShadowBlur2;
+
+	//*** Геометрия.
+	ptr<AttributeBinding> abFilter;
+	ptr<VertexBuffer> vbFilter;
+	ptr<IndexBuffer> ibFilter;
+	ptr<VertexBuffer> vbDebug;
+	ptr<IndexBuffer> ibDebug;
+
+	//*** Шейдеры.
+	ptr<VertexShader> vsFilter;
+	ptr<VertexShader> vsSky;
+	ptr<PixelShader> psSky;
+	ptr<VertexShader> vsDebug;
+	ptr<PixelShader> psDebug;
+	ptr<PixelShader> psTone;
+
+	//*** Семплеры.
+	ptr<SamplerState> ssPoint, ssLinear, ssPointBorder;
+
+	//*** Атрибуты.
+	/// Атрибуты отладочной геометрии.
+	struct DebugAttributes
+	{
+		ptr<AttributeBinding> ab;
+		Value<vec3> position;
+		Value<vec3> color;
+
+		DebugAttributes(ptr<Device> device, ptr<GeometryFormats> geometryFormats);
+	} debugAttributes;
+
+	/// Uniform-группа сцены теней.
+	struct ShadowSceneUniforms
+	{
+		ptr<UniformGroup> group;
+		Uniform<mat4x4> viewProjTransform;
+
+		ShadowSceneUniforms(ptr<Device> device);
+	} shadowSceneUniforms;
+
+	/// Uniform-группа размытия тени.
+	struct ShadowBlurUniforms
+	{
+		ptr<UniformGroup> group;
+		Sampler<float, 2> sourceSampler;
+		Uniform<vec2> blurDirection;
+
+		ShadowBlurUniforms(ptr<Device> device);
+	} shadowBlurUniforms;
+
+	/// Интерполянты.
+	Interpolant<vec2> iTexcoord;
+	Interpolant<vec3> iColor;
+	Interpolant<float> iDepth;
+
+	/// Состояние текущего прохода.
+	/** Устанавливается в контекст на время каждой очистки и отрисовки, вне их контекст не меняется. */
+	struct PassState
+	{
+		FrameBuffer* frameBuffer;
+		Context::CullMode cullMode;
+		Context::DepthTestFunc depthTestFunc;
+		bool depthWrite;
+		UniformGroup* uniforms;
+		VertexShader* vertexShader;
+		PixelShader* pixelShader;
+		VertexBuffer* vertexBuffer;
+		IndexBuffer* indexBuffer;
+		AttributeBinding* attributeBinding;
+		bool mainSource;
+	} pass;
+
+private:
+	void ResizeScreen(int screenWidth, int screenHeight);
+	/// Повернуть вектор кватернионом.
+	static Value<vec3> ApplyQuaternion(Value<vec4> q, Value<vec3> v);
+
+	//*** Временные переменные пиксельного шейдера материала.
+	Temp<vec4> tmpWorldPosition;
+	Temp<vec2> tmpTexcoord;
+	Temp<vec3> tmpNormal;
+	Temp<vec3> tmpToCamera;
+	Temp<vec4> tmpDiffuse, tmpSpecular;
+	Temp<float> tmpSpecularExponent;
+	Temp<vec3> tmpColor;
+
+	//*** CommandSink.
+	void BeginPass(PassTarget target);
+	void EndPass();
+	void ClearColor(const vec4& color);
+	void ClearDepth(float depth);
+	void SetCullMode(Context::CullMode cullMode);
+	void SetDepthTestFunc(Context::DepthTestFunc depthTestFunc);
+	void SetDepthWrite(bool depthWrite);
+	void SetUniforms(UniformsId uniforms, const Frame& frame);
+	void SetProgram(ProgramId program);
+	void SetGeometry(GeometryId geometry);
+	void SetMainSource();
+	void UploadDebugVertices(const GeometryFormats::Debug::Vertex* vertices, int count);
+	void DrawCall(int indicesCount);
+
+public:
+	DevicePainter(ptr<Device> device, ptr<Context> context, ptr<Presenter> presenter, ptr<Output> output, ptr<ShaderCache> shaderCache, ptr<GeometryFormats> geometryFormats);
+
+	void Draw();
+};
+
+#endif
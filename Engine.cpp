@@ -1,24 +1,67 @@
 #include "Engine.hpp"
-#include "Painter.hpp"
+#include "DevicePainter.hpp"
+#include "NullPainter.hpp"
 #include "Geometry.hpp"
 #include "GeometryFormats.hpp"
+#include "memory/frame_allocator.hpp"
+#include "profiler/scope_profiler.h"
+#include "memory/allocation_tracker.hpp"
 #include "../inanity/inanity-sqlitefs.hpp"
 #include <iostream>
+#include <cstdlib>
+#include <chrono>
 
 static const float maxAngleChange = 0.1f;
 
 Engine::Engine() :
 	cameraAlpha(0),
-	cameraBeta(-3.1415926535897932f * 0.25f)
-{}
+	cameraBeta(-3.1415926535897932f * 0.25f),
+	renderLatency(1),
+	frameStatsUpdate(nullptr),
+	headless(false),
+	fixedFrameTime(0)
+{
+	frameStats.track("SpatialBuild", "index");
+	frameStats.track("RvoStep", "rvo");
+	frameStats.track("Scripts", "scripts");
+	frameStats.track("PainterDraw", "draw");
+	frameStats.track("Present", "present");
+}
 
 Engine::~Engine()
 {
 	delete spatialIndex;
 }
 
+void Engine::InitSimulation()
+{
+	// spatial index
+	//spatialIndex = NEW(Spatial::Quadtree<Firstblood::ISpatiallyIndexable>(5, 512.0f, 32 * 1024));
+	spatialIndex = NEW(Spatial::KdTree<Firstblood::ISpatiallyIndexable>(8, 32 * 1024));
+	// rvo
+	// initial capacity only, the simulation grows on demand
+	rvoSimulation = NEW(Firstblood::RvoSimulation(512));
+	rvoSimulation->setJobSystem(&jobs);
+	rvoSimulation->setSpatialIndex(spatialIndex);
+	spatialRegistry.addProvider(rvoSimulation);
+	// scripts
+	scripts = NEW(Firstblood::ScriptSystem(painter, rvoSimulation, &cameraViewMatrix, spatialIndex));
+
+	ScopeProfiler::setThreadName("main");
+	traceCapture.startFromEnvironment();
+}
+
 void Engine::Run()
 {
+	// FIRSTBLOOD_HEADLESS=<ticks> runs the simulation alone, for benchmarks and servers
+	const char* headlessVariable = getenv("FIRSTBLOOD_HEADLESS");
+	if(headlessVariable && *headlessVariable)
+	{
+		int ticksLimit = atoi(headlessVariable);
+		RunHeadless(ticksLimit > 0 ? ticksLimit : ENGINE_HEADLESS_DEFAULT_TICKS);
+		return;
+	}
+
 	try
 	{
 		ptr<Graphics::System> system = Inanity::Platform::Game::CreateDefaultGraphicsSystem();
@@ -65,22 +108,27 @@ void Engine::Run()
 
 		geometryFormats = NEW(GeometryFormats());
 
-		painter = NEW(Painter(device, context, presenter, output, shaderCache, geometryFormats));
+		painter = NEW(DevicePainter(device, context, presenter, output, shaderCache, geometryFormats));
 
 		textureManager = NEW(TextureManager(fileSystem, device));
 		fontManager = NEW(FontManager(fileSystem, textureManager));
 		textDrawer = TextDrawer::Create(device, shaderCache);
 		font = fontManager->Get("mnogobukov.font");
 
-		boxGeometry = LoadDebugGeometry("box.geo");
+#ifdef PRODUCTION
+		// files of the blob are views into memory, reading them takes no time, so the loader reads on this thread
+		assetLoader = NEW(AssetLoader(fileSystem, device, geometryFormats, nullptr));
+#else
+		// loading jobs get a file system of their own, see AssetLoader
+		assetLoader = NEW(AssetLoader(NEW(Platform::FileSystem("res")), device, geometryFormats, &jobs));
+#endif
+		boxGeometry = assetLoader->LoadGeometry("box.geo");
 
-		// spatial index
-		//spatialIndex = NEW(Spatial::Quadtree<Firstblood::ISpatiallyIndexable>(5, 512.0f, 32 * 1024));
-		spatialIndex = NEW(Spatial::KdTree<Firstblood::ISpatiallyIndexable>(8, 32 * 1024));
-		// rvo
-		rvoSimulation = NEW(Firstblood::RvoSimulation(512, spatialIndex));
-		// scripts
-		scripts = NEW(Firstblood::ScriptSystem(painter, rvoSimulation, &cameraViewMatrix, spatialIndex));
+		InitSimulation();
+		// 0 draws a frame right after its simulation, 1 draws it while the next one is simulated
+		const char* renderLatencyVariable = getenv("FIRSTBLOOD_RENDER_LATENCY");
+		if(renderLatencyVariable && *renderLatencyVariable)
+			renderLatency = atoi(renderLatencyVariable) > 0 ? 1 : 0;
 
 		try
 		{
@@ -99,16 +147,131 @@ void Engine::Run()
 	}
 }
 
+void Engine::RunHeadless(int ticksLimit)
+{
+	try
+	{
+		headless = true;
+		// the projection is still computed for scripts
+		screenWidth = 1024;
+		screenHeight = 600;
+
+		painter = NEW(NullPainter());
+
+		InitSimulation();
+		// nothing is presented, so there is nothing to draw behind
+		renderLatency = 0;
+		// ticks go as fast as they can, but the game sees a steady frame rate
+		const char* frameTimeVariable = getenv("FIRSTBLOOD_HEADLESS_DT");
+		fixedFrameTime = frameTimeVariable && *frameTimeVariable ? (float)atof(frameTimeVariable) : 0;
+		if(fixedFrameTime <= 0)
+			fixedFrameTime = 1.0f / 60;
+
+		// FIRSTBLOOD_HEADLESS_NOALLOC=<warm-up ticks> fails the run if a tick after the warm-up allocates
+		const char* noAllocVariable = getenv("FIRSTBLOOD_HEADLESS_NOALLOC");
+		int noAllocWarmup = -1;
+		if(noAllocVariable && *noAllocVariable)
+		{
+#if defined(FIRSTBLOOD_TRACK_ALLOCATIONS)
+			noAllocWarmup = atoi(noAllocVariable) > 0 ? atoi(noAllocVariable) : ENGINE_HEADLESS_NOALLOC_DEFAULT_WARMUP;
+			AllocationTracker::getInstance().setSamplePeriod(1);
+#else
+			THROW("FIRSTBLOOD_HEADLESS_NOALLOC needs a build with FIRSTBLOOD_TRACK_ALLOCATIONS");
+#endif
+		}
+
+		std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+		try
+		{
+			for(int i = 0; i < ticksLimit; ++i)
+			{
+				Tick();
+#if defined(FIRSTBLOOD_TRACK_ALLOCATIONS)
+				if(noAllocWarmup >= 0 && i >= noAllocWarmup)
+				{
+					// the tick becomes the tracker's last frame
+					AllocationTracker& tracker = AllocationTracker::getInstance();
+					tracker.beginFrame();
+					if(tracker.getFrameCounters().count > 0)
+					{
+						printf("headless: tick %d after the warm-up allocates:\n", i - noAllocWarmup);
+						tracker.report(stdout);
+						fflush(stdout);
+						THROW("Headless tick allocates after the warm-up");
+					}
+				}
+#endif
+			}
+		}
+		catch(Exception* exception)
+		{
+			THROW_SECONDARY("Error while running headless game", exception);
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+		printf("headless: %d ticks of %.4f s in %.3f s, %.3f ms per tick, %.1f ticks per second\n",
+			ticksLimit, fixedFrameTime, seconds, seconds * 1000 / ticksLimit, ticksLimit / seconds);
+		scripts->reportStartup(stdout);
+		jobs.wait(frameStatsUpdate);
+		const std::vector<std::string>& lines = frameStats.getLines();
+		for(size_t i = 0; i < lines.size(); ++i)
+			printf("%s\n", lines[i].c_str());
+		fflush(stdout);
+
+		scripts->fini();
+	}
+	catch(Exception* exception)
+	{
+		THROW_SECONDARY("Can't run headless game", exception);
+	}
+}
+
 void Engine::Tick()
 {
-	float frameTime = ticker.Tick();
+	float frameTime = fixedFrameTime > 0 ? fixedFrameTime : ticker.Tick();
+	// the overlay may have been skipped, and the update reads what endFrame replaces
+	if(frameStatsUpdate)
+		jobs.wait(frameStatsUpdate);
+	// collect profiling results of the previous frame
+	ScopeProfiler::endFrame();
+	traceCapture.onFrameCollected();
+	// percentiles are recomputed meanwhile the frame goes on, lines are needed only for the overlay
+	frameStatsUpdate = jobs.create([](void* frameStats, size_t, size_t)
+	{
+		static_cast<FrameStats*>(frameStats)->onFrameCollected();
+	}, &frameStats);
+	jobs.submit(frameStatsUpdate);
+	Spatial::collectQueryCounters();
+	AllocationTracker::getInstance().beginFrame();
+	SCOPE_PROFILER(EngineTick);
+	FrameAllocator::getInstance().beginFrame();
+
+	// device resources of assets read since the last frame
+	if(assetLoader)
+	{
+		SCOPE_PROFILER(AssetUpdate);
+		assetLoader->Update(ASSET_LOADER_FRAME_BUDGET);
+	}
 
-	ptr<Input::Frame> inputFrame = inputManager->GetCurrentFrame();
-	const Input::State& inputState = inputFrame->GetCurrentState();
-	scripts->setInputState(&inputState);
-	while(inputFrame->NextEvent())
+	// no input without a window
+	ptr<Input::Frame> inputFrame;
+	if(inputManager)
+	{
+		inputFrame = inputManager->GetCurrentFrame();
+		scripts->setInputState(&inputFrame->GetCurrentState());
+	}
+	while(inputFrame && inputFrame->NextEvent())
 	{
 		const Input::Event& inputEvent = inputFrame->GetCurrentEvent();
+		if(inputEvent.device == Input::Event::deviceKeyboard && inputEvent.keyboard.type == Input::Event::Keyboard::typeKeyDown
+			&& inputEvent.keyboard.key == Input::Keys::F12 && !traceCapture.isCapturing())
+			traceCapture.start("trace.json");
+#if defined(FIRSTBLOOD_TRACK_ALLOCATIONS)
+		// allocations of the previous frame by zones and call sites
+		if(inputEvent.device == Input::Event::deviceKeyboard && inputEvent.keyboard.type == Input::Event::Keyboard::typeKeyDown
+			&& inputEvent.keyboard.key == Input::Keys::F11)
+			AllocationTracker::getInstance().report(stdout);
+#endif
 		scripts->handleInputEvent(inputEvent);
 	}
 
@@ -116,7 +279,11 @@ void Engine::Tick()
 	// рисование кадра
 
 	painter->BeginFrame(frameTime);
-	Step(frameTime);
+	// jobs of the step run on workers while the previous frame is drawn here
+	StartStep(frameTime);
+	if(renderLatency > 0)
+		DrawFrame();
+	FinishStep(frameTime);
 
 	const vec3 sunDirection = normalize(vec3(-1, -1, -1));
 	mat4x4 sunTransform =
@@ -127,7 +294,26 @@ void Engine::Tick()
 	vec3 translation(cameraViewMatrix(3, 0), cameraViewMatrix(3, 1), cameraViewMatrix(3, 2));
 	painter->SetCamera(projMatrix * cameraViewMatrix, translation);
 	painter->SetupPostprocess(1.0f, 1.0f, 1.0f);
-	painter->Draw();
+	painter->SubmitFrame();
+
+	if(renderLatency == 0)
+		DrawFrame();
+}
+
+void Engine::DrawFrame()
+{
+	// nothing is submitted yet on the first frame of the pipelined mode
+	if(!painter->HasSubmittedFrame())
+		return;
+
+	{
+		SCOPE_PROFILER(PainterDraw);
+		painter->Draw();
+	}
+
+	// headless: no overlay and nothing to present
+	if(!presenter)
+		return;
 
 	Context::LetFrameBuffer lfb(context, presenter->GetFrameBuffer());
 	Context::LetViewport lv(context, screenWidth, screenHeight);
@@ -135,38 +321,39 @@ void Engine::Tick()
 	textDrawer->Prepare(context, screenWidth, screenHeight);
 	textDrawer->SetFont(font);
 
-	// fps
+	// frame statistics
 	{
-		static int tickCount = 0;
-		static const int needTickCount = 100;
-		static float allTicksTime = 0;
-		allTicksTime += frameTime;
-		static float lastAllTicksTime = 0;
-		if(++tickCount >= needTickCount)
-		{
-			lastAllTicksTime = allTicksTime;
-			allTicksTime = 0;
-			tickCount = 0;
-		}
-		char fpsString[64];
-		sprintf(fpsString, "frameTime: %.6f sec, FPS: %.6f\n", lastAllTicksTime / needTickCount, needTickCount / lastAllTicksTime);
-		textDrawer->DrawTextLine(fpsString, -0.95f - 2.0f / screenWidth, -0.8f - 2.0f / screenHeight, vec4(1, 1, 1, 1), FontAlignments::Left | FontAlignments::Bottom);
-		textDrawer->DrawTextLine(fpsString, -0.95f, -0.8f, vec4(1, 0, 0, 1), FontAlignments::Left | FontAlignments::Bottom);
+		jobs.wait(frameStatsUpdate);
+		const std::vector<std::string>& lines = frameStats.getLines();
+		for(size_t i = 0; i < lines.size(); ++i)
+			textDrawer->DrawTextLine(lines[i], -0.95f, -0.8f + 0.06f * (float)(lines.size() - 1 - i), vec4(1, 1, 1, 1), FontAlignments::Left | FontAlignments::Bottom);
+#if defined(SPATIAL_QUERY_COUNTERS)
+		// per query averages tell bad tree shape (many nodes, few hits) from just large K
+		const Spatial::QueryCounters& counters = Spatial::getFrameQueryCounters();
+		double queries = (double)std::max<uint64_t>(counters.values[Spatial::counterNeighbourQueries] + counters.values[Spatial::counterRaycasts], 1);
+		char countersLine[160];
+		sprintf(countersLine, "spatial  queries %u  nodes/q %.1f  pruned/q %.1f  tested/q %.1f  hits/q %.1f  arena %u KB",
+			(unsigned)queries, counters.values[Spatial::counterNodesVisited] / queries, counters.values[Spatial::counterSubtreesPruned] / queries,
+			counters.values[Spatial::counterInhabitantsTested] / queries, counters.values[Spatial::counterHits] / queries,
+			(unsigned)(counters.values[Spatial::counterArenaBytes] / 1024));
+		textDrawer->DrawTextLine(countersLine, -0.95f, -0.86f, vec4(1, 1, 1, 1), FontAlignments::Left | FontAlignments::Bottom);
+#endif
+#if defined(FIRSTBLOOD_TRACK_ALLOCATIONS)
+		const AllocationCounters& allocations = AllocationTracker::getInstance().getFrameCounters();
+		char allocationsLine[96];
+		sprintf(allocationsLine, "heap     %u allocations  %u bytes (F11 for details)", (unsigned)allocations.count, (unsigned)allocations.bytes);
+		textDrawer->DrawTextLine(allocationsLine, -0.95f, -0.92f, allocations.count > 0 ? vec4(1, 0.3f, 0.3f, 1) : vec4(1, 1, 1, 1), FontAlignments::Left | FontAlignments::Bottom);
+#endif
 		textDrawer->Flush();
 	}
 
-	presenter->Present();
+	{
+		SCOPE_PROFILER(Present);
+		presenter->Present();
+	}
 }
 
 ptr<Texture> Engine::LoadTexture(const String& fileName)
 {
 	return textureManager->Get(fileName);
 }
-
-ptr<Geometry> Engine::LoadDebugGeometry(const String& fileName)
-{
-	return NEW(Geometry(
-		device->CreateStaticVertexBuffer(fileSystem->LoadFile(fileName + ".vertices"), geometryFormats->debug.vl),
-		device->CreateStaticIndexBuffer(fileSystem->LoadFile(fileName + ".indices"), sizeof(short))
-	));
-}
@@ -7,7 +7,17 @@
 #include "rvo/simulator.hpp"
 #include "gamelogic/common.hpp"
 #include "gamelogic/rvo.hpp"
+#include "gamelogic/spatial_registry.hpp"
 #include "script/system.hpp"
+#include "profiler/trace_capture.h"
+#include "profiler/frame_stats.h"
+#include "jobs/job_system.hpp"
+#include "AssetLoader.hpp"
+
+// ticks run by FIRSTBLOOD_HEADLESS without a number
+#define ENGINE_HEADLESS_DEFAULT_TICKS 1000
+// warm-up ticks of FIRSTBLOOD_HEADLESS_NOALLOC without a number
+#define ENGINE_HEADLESS_NOALLOC_DEFAULT_WARMUP 100
 
 class Geometry;
 class GeometryFormats;
@@ -36,6 +46,8 @@ protected:
 
 	// spatial index
 	Spatial::IIndex2D<Firstblood::ISpatiallyIndexable>* spatialIndex;
+	// subsystems whose entities go to the spatial index
+	Firstblood::SpatialRegistry spatialRegistry;
 	// rvo
 	ptr<Firstblood::RvoSimulation> rvoSimulation;
 	// scripts
@@ -47,10 +59,36 @@ protected:
 	float cameraAlpha, cameraBeta;
 
 	Ticker ticker;
-
-	ptr<Geometry> boxGeometry;
-
-	virtual void Step(float frameTime) = 0;
+	// chrome trace of profiler zones, by FIRSTBLOOD_TRACE or F12
+	TraceCapture traceCapture;
+	// frame time percentiles with subsystems breakdown
+	FrameStats frameStats;
+	// worker threads for the frame's jobs, the main thread joins them while waiting
+	JobSystem jobs;
+	// assets read by jobs, so declared after them to be destroyed first
+	ptr<AssetLoader> assetLoader;
+	// frames drawn behind the simulation, 0 or 1, FIRSTBLOOD_RENDER_LATENCY overrides
+	int renderLatency;
+	// percentiles of the previous frame, waited for by the overlay
+	Job* frameStatsUpdate;
+
+	// no window, device or presenter, painter only records frames
+	bool headless;
+	// steady frame time for headless ticks, 0 measures real time
+	float fixedFrameTime;
+
+	ptr<AssetLoader::GeometryHandle> boxGeometry;
+
+	// the step is split so that the frame can be drawn between the two: StartStep only submits jobs,
+	// FinishStep waits for them and runs the rest on the main thread
+	virtual void StartStep(float frameTime) = 0;
+	virtual void FinishStep(float frameTime) = 0;
+	// spatial index, rvo and scripts, after the painter is created
+	void InitSimulation();
+	// ticks as fast as possible with fixedFrameTime and prints timings
+	void RunHeadless(int ticksLimit);
+	// draws the last submitted frame with the overlay and presents it
+	void DrawFrame();
 
 public:
 	Engine();
@@ -60,7 +98,6 @@ public:
 	void Tick();
 
 	ptr<Texture> LoadTexture(const String& fileName);
-	ptr<Geometry> LoadDebugGeometry(const String& fileName);
 };
 
 #endif
@@ -5,7 +5,7 @@
 #include <random>
 #include "profiler/scope_profiler.h"
 
-Game::Game()
+Game::Game() : stepTime(0), stepJobs(nullptr)
 {
 	// debug crap
 	quadtree = new Spatial::Quadtree<QuadtreeDebugObject>(4, 32, 1024 * 1024);
@@ -19,27 +19,57 @@ Game::~Game()
 	delete kdTree;
 }
 
-void Game::Step(float frameTime)
+void Game::StartStep(float frameTime)
 {
-	// purge spatial index
-	spatialIndex->purge();
-	
-	// collect spatial entities from all subsystems
-	size_t entitiesCollected = 0;
-	Firstblood::ISpatiallyIndexable* spatialEntities[1024];
-	entitiesCollected += rvoSimulation->collectSpatialData(spatialEntities, 1024 - entitiesCollected);
-
-	// build spatial index
-	spatialIndex->build(spatialEntities, entitiesCollected);
-	spatialIndex->optimize();
-
-	// rvo simulation
-	rvoSimulation->update(20 * frameTime);
-	// run scripts 
-	scripts->update(20 * frameTime);
+	stepTime = 20 * frameTime;
+
+	// collect spatial entities from all subsystems, before any of them moves
+	spatialRegistry.collect(&jobs);
+
+	// rvo takes neighbours from the spatial index, so it's solved once the index is built,
+	// solving doesn't move agents, velocities are applied after it, in parallel chunks as well
+	Job* buildIndex = jobs.create([](void* data, size_t, size_t)
+	{
+		SCOPE_PROFILER(SpatialBuild);
+		Game* game = static_cast<Game*>(data);
+		game->spatialIndex->purge();
+		if (game->spatialRegistry.getEntitiesCount() > 0)
+			game->spatialIndex->build(game->spatialRegistry.getEntities(), game->spatialRegistry.getEntitiesCount());
+		game->spatialIndex->optimize();
+	}, this);
+	Job* solveRvo = jobs.create([](void* data, size_t, size_t)
+	{
+		SCOPE_PROFILER(RvoStep);
+		Game* game = static_cast<Game*>(data);
+		game->rvoSimulation->solveStep(game->stepTime);
+	}, this);
+	stepJobs = jobs.create([](void* data, size_t, size_t)
+	{
+		SCOPE_PROFILER(RvoStep);
+		Game* game = static_cast<Game*>(data);
+		game->rvoSimulation->applyNewVelocities(game->stepTime);
+	}, this);
+	jobs.addDependency(solveRvo, buildIndex);
+	jobs.addDependency(stepJobs, solveRvo);
+	jobs.submit(stepJobs);
+	jobs.submit(solveRvo);
+	jobs.submit(buildIndex);
+}
+
+void Game::FinishStep(float frameTime)
+{
+	SCOPE_PROFILER(GameStep);
+	jobs.wait(stepJobs);
+
+	// scripts stay on the main thread with the virtual machine
+	{
+		SCOPE_PROFILER(Scripts);
+		scripts->update(stepTime);
+	}
 
 	// do cleanup for each subsystem (for example, execute deferred script requests for objects' addition/removal)
 	rvoSimulation->postUpdate();
 
-	Thread::Sleep(10);
+	if(!headless)
+		Thread::Sleep(10);
 }
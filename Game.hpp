@@ -28,12 +28,18 @@ public:
 	~Game();
 
 protected:
-	void Step(float frameTime);
+	void StartStep(float frameTime);
+	void FinishStep(float frameTime);
 	//void drawQuadtreeNode(Quadtree::Node* node);
 	//void drawKdTreeNode(KdTree::Node* node);
 
 
 protected:
+	// state of the step between StartStep and FinishStep
+	float stepTime;
+	// finishes when agents are moved and the spatial index is built
+	Job* stepJobs;
+
 	// debug crap
 	std::vector<std::pair<Firstblood::RvoAgent*, vec2>> agents;
 	Spatial::Quadtree<QuadtreeDebugObject>* quadtree;
@@ -0,0 +1,14 @@
+#ifndef ___FIRSTBLOOD_NULL_PAINTER_HPP___
+#define ___FIRSTBLOOD_NULL_PAINTER_HPP___
+
+#include "Painter.hpp"
+
+/// Рисователь без графического устройства, для headless режима.
+/** Кадры собираются как обычно (скрипты рисуют отладочную геометрию), но никуда не рисуются. */
+class NullPainter : public Painter
+{
+public:
+	void Draw() {}
+};
+
+#endif
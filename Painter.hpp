@@ -3,93 +3,53 @@
 
 #include "general.hpp"
 #include "GeometryFormats.hpp"
-#include <unordered_map>
-
-class Geometry;
+#include "memory/frame_allocator.hpp"
 
 /// Рисователь мира.
+/** Собирает кадр: камеру, освещение и отладочную геометрию.
+Рисуют его наследники: DevicePainter на графическом устройстве, NullPainter никак. */
 class Painter : public Object
 {
-private:
-	/// Размер карты теней.
-	static const int shadowMapSize;
+protected:
 	/// Количество индексов в буфере отладочной геометрии.
+	/** Отладочная геометрия рисуется порциями такого размера. */
 	static const int debugVerticesBufferCount;
+	/// Количество индексов квада фильтров: два треугольника.
+	static const int filterQuadIndicesCount;
 
-	ptr<Device> device;
-	ptr<Context> context;
-	ptr<Presenter> presenter;
-	ptr<Output> output;
-	//** Размер экрана.
-	/** Получается из Output на каждом кадре. */
-	int screenWidth, screenHeight;
-	/// Кэш бинарных шейдеров.
-	ptr<ShaderCache> shaderCache;
-	/// Форматы геометрии.
-	ptr<GeometryFormats> geometryFormats;
-
-	/// Основной буфер кадра.
-	ptr<RenderBuffer> rbMain;
-	/// Основная карта глубины.
-	ptr<DepthStencilBuffer> dsbMain;
-	/// Карта теней.
-	ptr<RenderBuffer> rbShadow;
-	/// Карта глубины для теней.
-	ptr<DepthStencilBuffer> dsbShadow;
-	/// Вспомогательный буфер для размытия тени.
-	ptr<RenderBuffer> rbShadowBlur;
-
-	//*** Фреймбуферы.
-	ptr<FrameBuffer> fbMain, fbPreMain, fbShadow;
-	ptr<FrameBuffer> fbShadowBlur1, fbShadowBlur2;
-
-	//*** Геометрия.
-	ptr<AttributeBinding> abFilter;
-	ptr<VertexBuffer> vbFilter;
-	ptr<IndexBuffer> ibFilter;
-	ptr<VertexBuffer> vbDebug;
-	ptr<IndexBuffer> ibDebug;
-
-	//*** Шейдеры.
-	ptr<VertexShader> vsFilter;
-	ptr<VertexShader> vsSky;
-	ptr<PixelShader> psSky;
-	ptr<VertexShader> vsDebug;
-	ptr<PixelShader> psDebug;
-	ptr<PixelShader> psTone;
-
-	//*** Семплеры.
-	ptr<SamplerState> ssPoint, ssLinear, ssPointBorder;
-
-	//*** Атрибуты.
-	/// Атрибуты отладочной геометрии.
-	struct DebugAttributes
-	{
-		ptr<AttributeBinding> ab;
-		Value<vec3> position;
-		Value<vec3> color;
-
-		DebugAttributes(ptr<Device> device, ptr<GeometryFormats> geometryFormats);
-	} debugAttributes;
-
-	/// Uniform-группа сцены теней.
-	struct ShadowSceneUniforms
+	/// Всё, что нужно для рисования кадра.
+	/** Заполняется симуляцией, а рисуется неизменным, возможно пока симулируется следующий кадр. */
+	struct Frame
 	{
-		ptr<UniformGroup> group;
-		Uniform<mat4x4> viewProjTransform;
-
-		ShadowSceneUniforms(ptr<Device> device);
-	} shadowSceneUniforms;
-
-	/// Uniform-группа размытия тени.
-	struct ShadowBlurUniforms
-	{
-		ptr<UniformGroup> group;
-		Sampler<float, 2> sourceSampler;
-		Uniform<vec2> blurDirection;
-
-		ShadowBlurUniforms(ptr<Device> device);
-	} shadowBlurUniforms;
+		/// Текущее время кадра.
+		float frameTime;
+
+		// Текущая камера для opaque pass.
+		mat4x4 cameraViewProj;
+		mat4x4 cameraInvViewProj;
+		vec3 cameraPosition;
+
+		/// Настройки сцены.
+		vec3 ambientLight;
+		vec3 sunLight;
+		vec3 sunDirection;
+		mat4x4 sunTransform;
+
+		float bloomLimit;
+		float toneLuminanceKey;
+		float toneMaxLuminance;
+
+		/// Вершины отладочной геометрии.
+		/** Живут в памяти кадра, пересоздаются в BeginFrame.
+		Память кадра живёт ещё один кадр, так что отправленный кадр можно рисовать во время следующего. */
+		FrameVector<GeometryFormats::Debug::Vertex> debugVertices;
+	};
+	/// Два кадра по очереди: один заполняется, другой рисуется.
+	Frame frames[2];
+	/// Заполняемый кадр.
+	Frame* recordingFrame;
+	/// Последний отправленный кадр, nullptr до первой отправки.
+	Frame* submittedFrame;
 
 	/// Uniform-группа неба.
 	struct SkyUniforms
@@ -98,7 +58,7 @@ private:
 		Uniform<mat4x4> invViewProjTransform;
 		Uniform<vec3> cameraPosition;
 
-		SkyUniforms(ptr<Device> device);
+		SkyUniforms();
 	} skyUniforms;
 
 	/// Uniform-группа сцены цветового прохода.
@@ -112,7 +72,7 @@ private:
 		Uniform<vec3> sunLight;
 		Sampler<float, 2> sunShadowSampler;
 
-		ColorSceneUniforms(ptr<Device> device);
+		ColorSceneUniforms();
 	} colorSceneUniforms;
 
 	/// Uniform-группа tone mapping.
@@ -123,53 +83,68 @@ private:
 		Uniform<float> maxLuminance;
 		Sampler<vec3, 2> sourceSampler;
 
-		ToneUniforms(ptr<Device> device);
+		ToneUniforms();
 	} toneUniforms;
 
-	/// Интерполянты.
-	Interpolant<vec2> iTexcoord;
-	Interpolant<vec3> iColor;
-	Interpolant<float> iDepth;
-
-private:
-	void ResizeScreen(int screenWidth, int screenHeight);
-	/// Повернуть вектор кватернионом.
-	static Value<vec3> ApplyQuaternion(Value<vec4> q, Value<vec3> v);
-
-	//*** Временные переменные пиксельного шейдера материала.
-	Temp<vec4> tmpWorldPosition;
-	Temp<vec2> tmpTexcoord;
-	Temp<vec3> tmpNormal;
-	Temp<vec3> tmpToCamera;
-	Temp<vec4> tmpDiffuse, tmpSpecular;
-	Temp<float> tmpSpecularExponent;
-	Temp<vec3> tmpColor;
-
-	/// Текущее время кадра.
-	float frameTime;
-
-	//*** зарегистрированные объекты для рисования
-
-	// Текущая камера для opaque pass.
-	mat4x4 cameraViewProj;
-	mat4x4 cameraInvViewProj;
-	vec3 cameraPosition;
-
-	/// Настройки сцены.
-	vec3 ambientLight;
-	vec3 sunLight;
-	vec3 sunDirection;
-	mat4x4 sunTransform;
-
-	float bloomLimit;
-	float toneLuminanceKey;
-	float toneMaxLuminance;
-
-	/// Вершины отладочной геометрии.
-	std::vector<GeometryFormats::Debug::Vertex> debugVertices;
+	/// Получатель команд рисования кадра.
+	/** Последовательность команд одна, её выдаёт SubmitCommands: DevicePainter отдаёт команды контексту,
+	RecordingPainter считает их. Состояние, установленное командой, действует до конца прохода,
+	каждый проход начинается с состояния по умолчанию. */
+	class CommandSink
+	{
+	public:
+		enum PassTarget
+		{
+			targetPreMain,
+			targetMain,
+			targetPresenter
+		};
+		enum UniformsId
+		{
+			uniformsSky,
+			uniformsColorScene,
+			uniformsTone
+		};
+		enum ProgramId
+		{
+			programSky,
+			programDebug,
+			programTone
+		};
+		enum GeometryId
+		{
+			geometryFilter,
+			geometryDebug
+		};
+
+	public:
+		virtual ~CommandSink() {}
+
+		virtual void BeginPass(PassTarget target) = 0;
+		virtual void EndPass() = 0;
+		virtual void ClearColor(const vec4& color) = 0;
+		virtual void ClearDepth(float depth) = 0;
+		virtual void SetCullMode(Context::CullMode cullMode) = 0;
+		virtual void SetDepthTestFunc(Context::DepthTestFunc depthTestFunc) = 0;
+		virtual void SetDepthWrite(bool depthWrite) = 0;
+		/// Заполнить uniform-группу значениями кадра, загрузить её и установить.
+		virtual void SetUniforms(UniformsId uniforms, const Frame& frame) = 0;
+		/// Установить вершинный и пиксельный шейдеры.
+		virtual void SetProgram(ProgramId program) = 0;
+		/// Установить вершинный и индексный буферы с привязкой атрибутов.
+		virtual void SetGeometry(GeometryId geometry) = 0;
+		/// Установить основной буфер кадра источником постпроцессинга.
+		virtual void SetMainSource() = 0;
+		/// Загрузить порцию отладочных вершин, не больше debugVerticesBufferCount.
+		virtual void UploadDebugVertices(const GeometryFormats::Debug::Vertex* vertices, int count) = 0;
+		virtual void DrawCall(int indicesCount) = 0;
+	};
+
+	/// Выдать команды рисования отправленного кадра.
+	void SubmitCommands(CommandSink& sink) const;
 
 public:
-	Painter(ptr<Device> device, ptr<Context> context, ptr<Presenter> presenter, ptr<Output> output, ptr<ShaderCache> shaderCache, ptr<GeometryFormats> geometryFormats);
+	Painter();
 
 	/// Начать кадр.
 	/** Очистить все регистрационные списки. */
@@ -191,8 +166,14 @@ public:
 	/// Установить параметры постпроцессинга.
 	void SetupPostprocess(float bloomLimit, float toneLuminanceKey, float toneMaxLuminance);
 
-	/// Выполнить рисование.
-	void Draw();
+	/// Закончить заполнение кадра.
+	/** Кадр становится рисуемым, следующий BeginFrame начинает заполнять другой. */
+	void SubmitFrame();
+	/// Был ли отправлен хотя бы один кадр.
+	bool HasSubmittedFrame() const;
+
+	/// Нарисовать последний отправленный кадр.
+	virtual void Draw() = 0;
 };
 
 #endif
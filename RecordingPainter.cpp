@@ -0,0 +1,138 @@
+#include "RecordingPainter.hpp"
+
+//*** RecordingPainter
+
+/// Имена для журнала, в порядке перечислений CommandSink.
+static const char* const targetNames[] = { "premain", "main", "presenter" };
+static const char* const uniformsNames[] = { "sky", "color scene", "tone" };
+static const char* const programNames[] = { "sky", "debug", "tone" };
+static const char* const geometryNames[] = { "filter", "debug" };
+
+RecordingPainter::RecordingPainter() : counters(), log(nullptr) {}
+
+void RecordingPainter::SetLog(FILE* log)
+{
+	this->log = log;
+}
+
+const RecordingPainter::Counters& RecordingPainter::GetCounters() const
+{
+	return counters;
+}
+
+void RecordingPainter::SetState(const char* state, const char* value)
+{
+	++counters.stateChanges;
+	if(log)
+		fprintf(log, "set %s %s\n", state, value);
+}
+
+void RecordingPainter::BeginPass(PassTarget target)
+{
+	SetState("framebuffer", targetNames[target]);
+}
+
+void RecordingPainter::EndPass()
+{
+	if(log)
+		fprintf(log, "end pass\n");
+}
+
+void RecordingPainter::ClearColor(const vec4&)
+{
+	++counters.clears;
+	if(log)
+		fprintf(log, "clear color 0\n");
+}
+
+void RecordingPainter::ClearDepth(float)
+{
+	++counters.clears;
+	if(log)
+		fprintf(log, "clear depth\n");
+}
+
+void RecordingPainter::SetCullMode(Context::CullMode cullMode)
+{
+	SetState("cull", cullMode == Context::cullModeNone ? "none" : "on");
+}
+
+void RecordingPainter::SetDepthTestFunc(Context::DepthTestFunc depthTestFunc)
+{
+	SetState("depth test", depthTestFunc == Context::depthTestFuncAlways ? "always" : "on");
+}
+
+void RecordingPainter::SetDepthWrite(bool depthWrite)
+{
+	SetState("depth write", depthWrite ? "true" : "false");
+}
+
+void RecordingPainter::SetUniforms(UniformsId uniforms, const Frame&)
+{
+	UniformGroup* group = nullptr;
+	switch(uniforms)
+	{
+	case uniformsSky:
+		group = skyUniforms.group;
+		break;
+	case uniformsColorScene:
+		group = colorSceneUniforms.group;
+		break;
+	case uniformsTone:
+		group = toneUniforms.group;
+		break;
+	}
+	// размер группы с выравниванием uniform'ов, столько DevicePainter и загружает
+	size_t size = group->GetSize();
+	++counters.uniformUploads;
+	counters.uploadedBytes += size;
+	if(log)
+		fprintf(log, "upload uniforms %s %u\n", uniformsNames[uniforms], (unsigned)size);
+	SetState("uniforms", uniformsNames[uniforms]);
+}
+
+void RecordingPainter::SetProgram(ProgramId program)
+{
+	SetState("vertex shader", programNames[program]);
+	SetState("pixel shader", programNames[program]);
+}
+
+void RecordingPainter::SetGeometry(GeometryId geometry)
+{
+	SetState("vertex buffer", geometryNames[geometry]);
+	SetState("index buffer", geometryNames[geometry]);
+	SetState("attribute binding", geometryNames[geometry]);
+}
+
+void RecordingPainter::SetMainSource()
+{
+	SetState("sampler", "main point");
+}
+
+void RecordingPainter::UploadDebugVertices(const GeometryFormats::Debug::Vertex*, int count)
+{
+	size_t size = count * sizeof(GeometryFormats::Debug::Vertex);
+	++counters.vertexUploads;
+	counters.uploadedBytes += size;
+	if(log)
+		fprintf(log, "upload vertices debug %u\n", (unsigned)size);
+}
+
+void RecordingPainter::DrawCall(int indicesCount)
+{
+	++counters.draws;
+	counters.drawnVertices += indicesCount;
+	if(log)
+		fprintf(log, "draw %d\n", indicesCount);
+}
+
+void RecordingPainter::Draw()
+{
+	counters = Counters();
+	if(!submittedFrame)
+		return;
+
+	if(log)
+		fprintf(log, "frame %f\n", submittedFrame->frameTime);
+	SubmitCommands(*this);
+}
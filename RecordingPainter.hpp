@@ -0,0 +1,58 @@
+#ifndef ___FIRSTBLOOD_RECORDING_PAINTER_HPP___
+#define ___FIRSTBLOOD_RECORDING_PAINTER_HPP___
+
+#include "Painter.hpp"
+#include <cstdio>
+
+/// Рисователь, записывающий команды вместо графического устройства.
+/** Получает те же команды SubmitCommands, что и DevicePainter, и считает их.
+Нужен, чтобы измерять процессорную стоимость рисования на машинах без GPU. */
+class RecordingPainter : public Painter, private Painter::CommandSink
+{
+public:
+	/// Счётчики команд последнего Draw.
+	struct Counters
+	{
+		int draws;
+		int drawnVertices;
+		int clears;
+		/// Установки состояния контекста (буферов, шейдеров, семплеров и прочего).
+		int stateChanges;
+		int uniformUploads;
+		int vertexUploads;
+		size_t uploadedBytes;
+	};
+
+private:
+	Counters counters;
+	/// Куда писать журнал команд, nullptr - не писать.
+	FILE* log;
+
+	void SetState(const char* state, const char* value);
+
+	//*** CommandSink.
+	void BeginPass(PassTarget target);
+	void EndPass();
+	void ClearColor(const vec4& color);
+	void ClearDepth(float depth);
+	void SetCullMode(Context::CullMode cullMode);
+	void SetDepthTestFunc(Context::DepthTestFunc depthTestFunc);
+	void SetDepthWrite(bool depthWrite);
+	void SetUniforms(UniformsId uniforms, const Frame& frame);
+	void SetProgram(ProgramId program);
+	void SetGeometry(GeometryId geometry);
+	void SetMainSource();
+	void UploadDebugVertices(const GeometryFormats::Debug::Vertex* vertices, int count);
+	void DrawCall(int indicesCount);
+
+public:
+	RecordingPainter();
+
+	/// Писать журнал команд в файл, nullptr - перестать.
+	void SetLog(FILE* log);
+	const Counters& GetCounters() const;
+
+	void Draw();
+};
+
+#endif
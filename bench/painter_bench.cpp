@@ -0,0 +1,202 @@
+// benchmark of the painter's cpu side: recording of synthetic scenes and submission of their commands
+// commands go to RecordingPainter instead of a graphics device, so it runs on machines without gpu
+// usage: painter_bench [scene|all] [objects|all] [frames] [log]
+// log prints commands of the last frame of every run
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <random>
+#include <vector>
+#include "RecordingPainter.hpp"
+#include "memory/frame_allocator.hpp"
+
+#define BENCH_WARMUP_FRAMES 10
+#define BENCH_DEFAULT_FRAMES 200
+#define BENCH_FRAME_TIME (1.0f / 60)
+#define BENCH_WORLD_SIZE 512.0f
+
+namespace
+{
+
+	typedef std::chrono::high_resolution_clock Clock;
+
+	struct SceneObject
+	{
+		vec3 position;
+		vec3 velocity;
+		vec3 color;
+	};
+
+
+	// draws a set of objects the way gameplay scripts do
+	class Scene
+	{
+	public:
+		virtual ~Scene() {}
+		virtual const char* getName() const = 0;
+		virtual void draw(Painter* painter, const std::vector<SceneObject>& objects) const = 0;
+	};
+
+
+	// crowd agents: a circle with the velocity line, as main.js draws them
+	class CirclesScene : public Scene
+	{
+	public:
+		const char* getName() const { return "circles"; }
+
+		void draw(Painter* painter, const std::vector<SceneObject>& objects) const
+		{
+			for (size_t i = 0; i < objects.size(); ++i)
+			{
+				const SceneObject& object = objects[i];
+				painter->DebugDrawCircle(object.position, 1.5f, object.color, 16);
+				painter->DebugDrawLine(object.position, object.position + object.velocity, object.color);
+			}
+		}
+	};
+
+
+	class CubesScene : public Scene
+	{
+	public:
+		const char* getName() const { return "cubes"; }
+
+		void draw(Painter* painter, const std::vector<SceneObject>& objects) const
+		{
+			for (size_t i = 0; i < objects.size(); ++i)
+			{
+				const SceneObject& object = objects[i];
+				painter->DebugDrawAABB(object.position - vec3(1, 1, 1), object.position + vec3(1, 1, 1), object.color);
+			}
+		}
+	};
+
+
+	// spatial debug view: node bounds
+	class RectanglesScene : public Scene
+	{
+	public:
+		const char* getName() const { return "rects"; }
+
+		void draw(Painter* painter, const std::vector<SceneObject>& objects) const
+		{
+			for (size_t i = 0; i < objects.size(); ++i)
+			{
+				const SceneObject& object = objects[i];
+				painter->DebugDrawRectangle(object.position.x - 4, object.position.y - 4, object.position.x + 4, object.position.y + 4, 0, object.color);
+			}
+		}
+	};
+
+
+	struct Result
+	{
+		double recordMs;
+		double submitMs;
+		RecordingPainter::Counters counters;
+	};
+
+
+	Result run(const Scene& scene, size_t objectsCount, size_t frames, bool log)
+	{
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> coordinate(-BENCH_WORLD_SIZE * 0.5f, BENCH_WORLD_SIZE * 0.5f);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		std::vector<SceneObject> objects(objectsCount);
+		for (size_t i = 0; i < objectsCount; ++i)
+		{
+			objects[i].position = vec3(coordinate(random), coordinate(random), 0);
+			objects[i].velocity = vec3(unit(random), unit(random), 0) * 3.0f;
+			objects[i].color = vec3(unit(random) * 0.5f + 0.5f, unit(random) * 0.5f + 0.5f, 1);
+		}
+
+		const vec3 sunDirection = normalize(vec3(-1, -1, -1));
+		mat4x4 sunTransform =
+			CreateProjectionPerspectiveFovMatrix((float)M_PI / 4, 1.0f, 0.1f, 150.0f)
+			* CreateLookAtMatrix(sunDirection * -100.0f, vec3(0, 0, 0), vec3(0, 0, 1));
+		vec3 cameraPosition(0, -BENCH_WORLD_SIZE * 0.5f, BENCH_WORLD_SIZE * 0.5f);
+		mat4x4 cameraViewProj = CreateProjectionPerspectiveFovMatrix((float)M_PI / 4, 1024.0f / 600.0f, 0.1f, 1000.0f)
+			* CreateLookAtMatrix(cameraPosition, vec3(0, 0, 0), vec3(0, 0, 1));
+
+		ptr<RecordingPainter> painter = NEW(RecordingPainter());
+		Result result = Result();
+		for (size_t frame = 0; frame < BENCH_WARMUP_FRAMES + frames; ++frame)
+		{
+			bool measured = frame >= BENCH_WARMUP_FRAMES;
+			if (log && frame + 1 == BENCH_WARMUP_FRAMES + frames)
+				painter->SetLog(stdout);
+
+			FrameAllocator::getInstance().beginFrame();
+			for (size_t i = 0; i < objectsCount; ++i)
+				objects[i].position += objects[i].velocity * BENCH_FRAME_TIME;
+
+			Clock::time_point start = Clock::now();
+			painter->BeginFrame(BENCH_FRAME_TIME);
+			scene.draw(painter, objects);
+			painter->SetSceneLighting(vec3(1, 1, 1) * 0.1f, vec3(1, 1, 1), sunDirection, sunTransform);
+			painter->SetCamera(cameraViewProj, cameraPosition);
+			painter->SetupPostprocess(1.0f, 1.0f, 1.0f);
+			painter->SubmitFrame();
+			Clock::time_point recorded = Clock::now();
+			painter->Draw();
+			Clock::time_point submitted = Clock::now();
+
+			if (measured)
+			{
+				result.recordMs += std::chrono::duration<double, std::milli>(recorded - start).count();
+				result.submitMs += std::chrono::duration<double, std::milli>(submitted - recorded).count();
+			}
+		}
+		painter->SetLog(nullptr);
+		// the scene doesn't change its size, so the last frame's commands stand for all of them
+		result.counters = painter->GetCounters();
+		return result;
+	}
+
+}
+
+int main(int argc, char** argv)
+{
+	CirclesScene circles;
+	CubesScene cubes;
+	RectanglesScene rectangles;
+	const Scene* scenes[] = { &circles, &cubes, &rectangles };
+
+	size_t objectCounts[] = { 100, 1000, 10000 };
+	size_t objectCountsCount = sizeof(objectCounts) / sizeof(objectCounts[0]);
+	const char* sceneFilter = argc > 1 ? argv[1] : "all";
+	if (argc > 2 && strcmp(argv[2], "all") != 0)
+	{
+		objectCounts[0] = (size_t)atol(argv[2]);
+		objectCountsCount = 1;
+	}
+	size_t frames = argc > 3 ? (size_t)atol(argv[3]) : BENCH_DEFAULT_FRAMES;
+	bool log = argc > 4 && strcmp(argv[4], "log") == 0;
+
+	printf("%-10s %8s %8s %10s %10s %8s %8s %8s %10s\n", "scene", "objects", "frames", "record ms", "submit ms", "draws", "states", "uploads", "KB/frame");
+	bool found = false;
+	for (size_t i = 0; i < sizeof(scenes) / sizeof(scenes[0]); ++i)
+	{
+		const Scene& scene = *scenes[i];
+		if (strcmp(sceneFilter, "all") != 0 && strcmp(sceneFilter, scene.getName()) != 0)
+			continue;
+		found = true;
+		for (size_t j = 0; j < objectCountsCount; ++j)
+		{
+			Result result = run(scene, objectCounts[j], frames, log);
+			const RecordingPainter::Counters& counters = result.counters;
+			printf("%-10s %8u %8u %10.3f %10.3f %8d %8d %8d %10.1f\n", scene.getName(), (unsigned)objectCounts[j], (unsigned)frames,
+				result.recordMs / frames, result.submitMs / frames, counters.draws, counters.stateChanges,
+				counters.uniformUploads + counters.vertexUploads, counters.uploadedBytes / 1024.0);
+		}
+	}
+	if (!found)
+	{
+		fprintf(stderr, "unknown scene: %s (expected circles, cubes, rects or all)\n", sceneFilter);
+		return 1;
+	}
+	return 0;
+}
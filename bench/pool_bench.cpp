@@ -0,0 +1,170 @@
+// multithreaded stress test and benchmark of object pools
+// every thread keeps creating and destroying objects, part of them are handed over to other threads to be destroyed there;
+// each object carries a stamp of its owner which is checked on destruction, so a chunk given out twice is caught
+// usage: pool_bench [threads] [operations per thread]
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include "memory/pool.hpp"
+#include "memory/concurrent_pool.hpp"
+
+#define BENCH_DEFAULT_OPERATIONS 2000000
+#define BENCH_LIVE_OBJECTS 1024
+// every this many operations a thread swaps a batch of live objects with the others
+#define BENCH_HANDOVER_PERIOD 4096
+#define BENCH_HANDOVER_SIZE 64
+#define BENCH_STAMP_KEY 0x9e3779b97f4a7c15ull
+
+namespace
+{
+
+	typedef std::chrono::high_resolution_clock Clock;
+
+	// about the size of an agent
+	struct Item
+	{
+		uint64_t stamp;
+		uint64_t check;
+		uint64_t payload[14];
+
+		Item(uint64_t stamp) : stamp(stamp), check(stamp ^ BENCH_STAMP_KEY) {}
+		~Item() { check = 0; }
+	};
+
+
+	class ConcurrentPoolAdapter
+	{
+	public:
+		ConcurrentPoolAdapter() : _pool(512) {}
+		static const char* getName() { return "concurrent"; }
+		Item* create(uint64_t stamp) { return _pool.create(stamp); }
+		void destroy(Item* item) { _pool.destroy(item); }
+
+	private:
+		ConcurrentPool<Item> _pool;
+	};
+
+
+	// what sharing a plain pool between threads would take
+	class LockedPoolAdapter
+	{
+	public:
+		LockedPoolAdapter() : _pool(512) {}
+		static const char* getName() { return "mutex"; }
+
+		Item* create(uint64_t stamp)
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			return _pool.create(stamp);
+		}
+
+		void destroy(Item* item)
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_pool.destroy(item);
+		}
+
+	private:
+		std::mutex _mutex;
+		Pool<Item> _pool;
+	};
+
+
+	struct Handover
+	{
+		std::mutex mutex;
+		std::vector<Item*> items;
+	};
+
+
+	template<class PoolAdapter>
+	void work(PoolAdapter& pool, Handover& handover, size_t thread, size_t operations, std::atomic<size_t>& errors)
+	{
+		std::mt19937 random((unsigned)thread + 1);
+		std::vector<Item*> live;
+		live.reserve(BENCH_LIVE_OBJECTS + BENCH_HANDOVER_SIZE);
+		uint64_t sequence = 0;
+
+		for (size_t operation = 0; operation < operations; ++operation)
+		{
+			if (live.empty() || (live.size() < BENCH_LIVE_OBJECTS && (random() & 1)))
+			{
+				live.push_back(pool.create(((uint64_t)thread << 48) | sequence++));
+			}
+			else
+			{
+				size_t i = random() % live.size();
+				Item* item = live[i];
+				if (item->check != (item->stamp ^ BENCH_STAMP_KEY))
+					++errors;
+				live[i] = live.back();
+				live.pop_back();
+				pool.destroy(item);
+			}
+
+			if (operation % BENCH_HANDOVER_PERIOD == BENCH_HANDOVER_PERIOD - 1)
+			{
+				std::lock_guard<std::mutex> lock(handover.mutex);
+				for (size_t i = 0; i < BENCH_HANDOVER_SIZE && !live.empty(); ++i)
+				{
+					handover.items.push_back(live.back());
+					live.pop_back();
+				}
+				// take somebody else's objects, they will be destroyed here
+				size_t taken = std::min(handover.items.size(), (size_t)BENCH_HANDOVER_SIZE);
+				live.insert(live.end(), handover.items.begin(), handover.items.begin() + taken);
+				handover.items.erase(handover.items.begin(), handover.items.begin() + taken);
+			}
+		}
+
+		for (size_t i = 0; i < live.size(); ++i)
+		{
+			if (live[i]->check != (live[i]->stamp ^ BENCH_STAMP_KEY))
+				++errors;
+			pool.destroy(live[i]);
+		}
+	}
+
+	template<class PoolAdapter>
+	void run(size_t threadsCount, size_t operations)
+	{
+		PoolAdapter pool;
+		Handover handover;
+		std::atomic<size_t> errors(0);
+		std::vector<std::thread> threads;
+
+		Clock::time_point start = Clock::now();
+		for (size_t i = 0; i < threadsCount; ++i)
+			threads.push_back(std::thread(work<PoolAdapter>, std::ref(pool), std::ref(handover), i, operations, std::ref(errors)));
+		for (size_t i = 0; i < threadsCount; ++i)
+			threads[i].join();
+		// leftovers of the handover are destroyed by the main thread
+		for (size_t i = 0; i < handover.items.size(); ++i)
+			pool.destroy(handover.items[i]);
+		double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+		printf("%-12s %8u %12u %12.2f %8u\n", PoolAdapter::getName(), (unsigned)threadsCount, (unsigned)operations,
+			seconds * 1e9 / (double)(threadsCount * operations), (unsigned)errors.load());
+		fflush(stdout);
+	}
+
+}
+
+int main(int argc, char** argv)
+{
+	size_t threadsCount = argc > 1 ? (size_t)atol(argv[1]) : (size_t)std::thread::hardware_concurrency();
+	if (threadsCount == 0)
+		threadsCount = 1;
+	size_t operations = argc > 2 ? (size_t)atol(argv[2]) : BENCH_DEFAULT_OPERATIONS;
+
+	printf("%-12s %8s %12s %12s %8s\n", "pool", "threads", "ops/thread", "ns/op", "errors");
+	run<ConcurrentPoolAdapter>(threadsCount, operations);
+	run<LockedPoolAdapter>(threadsCount, operations);
+	return 0;
+}
@@ -0,0 +1,501 @@
+// headless crowd benchmark
+// links only rvo/, spatial/, memory/ and geometry/, so it runs without window, graphics device or scripts
+// usage: rvo_bench [scenario|all] [agents|all] [steps] [lod] [flow] [noreorder] [noalloc] [jobs]
+// noalloc fails the run if a step allocates after the warm-up, needs a build with FIRSTBLOOD_TRACK_ALLOCATIONS
+// jobs spreads per-agent phases over all hardware threads
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+#include "rvo/simulator.hpp"
+#include "rvo/agent.hpp"
+#include "rvo/flow_field.hpp"
+#include "memory/pool.hpp"
+#include "spatial/kd_tree.hpp"
+#include "spatial/query_counters.hpp"
+#include "memory/allocation_tracker.hpp"
+#include "jobs/job_system.hpp"
+
+#define BENCH_WARMUP_STEPS 10
+#define BENCH_DEFAULT_STEPS 100
+#define BENCH_TIME_STEP 0.25f
+// what the engine starts with, bigger crowds go through the growth path
+#define BENCH_INITIAL_CAPACITY 512
+
+namespace
+{
+
+	typedef std::chrono::high_resolution_clock Clock;
+
+	class BenchAgent : public RVO::Agent
+	{
+	public:
+		vec2 goal;
+
+		// entity interface of the spatial trees
+		bool raycast(const vec3& /*origin*/, const vec3& /*end*/, float& /*dist*/) { return true; }
+		float getRadius() { return radius; }
+		vec3 getPosition() { return vec3(position.x, position.y, 0); }
+		uint32_t getMask() { return mask; }
+	};
+
+
+	// stands for the game's global spatial index, built once per step from the agents themselves
+	class BenchNeighborIndex : public RVO::INeighborIndex
+	{
+	public:
+		BenchNeighborIndex() : _tree(8, 64 * 1024 * 1024) {}
+
+		void build(std::vector<BenchAgent*>& agents)
+		{
+			_tree.purge();
+			if (!agents.empty())
+				_tree.build(agents.data(), agents.size());
+			_tree.optimize();
+		}
+
+		size_t getNeighborAgents(const RVO::Agent* agent, float distance, uint32_t* result, size_t maxResultLength) const
+		{
+			BenchAgent* self = const_cast<BenchAgent*>(static_cast<const BenchAgent*>(agent));
+			Spatial::NearestNeighbor<BenchAgent> found[RVO_GET_NEAREST_AGENTS_MAX_BUFFER_SIZE];
+			size_t count = _tree.getNeighbours(vec3(agent->position.x, agent->position.y, 0), distance, agent->mask, found,
+				std::min(maxResultLength, RVO_GET_NEAREST_AGENTS_MAX_BUFFER_SIZE), self);
+			for (size_t i = 0; i < count; ++i)
+				result[i] = (uint32_t)found[i].entity->getIndex();
+			return count;
+		}
+
+	private:
+		Spatial::KdTree<BenchAgent> _tree;
+	};
+
+
+	class Crowd
+	{
+	public:
+		Crowd(size_t initialCapacity) : simulator(initialCapacity), _pool(initialCapacity)
+		{
+			// the same defaults main.js feeds to the engine
+			simulator.setAgentDefaults(15.0f, 8, 15.0f, 1.5f, 1.0f);
+		}
+
+		~Crowd()
+		{
+			for (size_t i = 0; i < agents.size(); ++i)
+				_pool.destroy(agents[i]);
+		}
+
+		BenchAgent* add(const vec2& position, const vec2& goal)
+		{
+			BenchAgent* agent = _pool.create();
+			simulator.applyDefaultsToAgent(agent);
+			agent->position = position;
+			agent->prefVelocity = vec2(0, 0);
+			agent->goal = goal;
+			simulator.addAgent(agent);
+			agents.push_back(agent);
+			return agent;
+		}
+
+		void remove(size_t i)
+		{
+			BenchAgent* agent = agents[i];
+			simulator.removeAgent(agent);
+			agents[i] = agents.back();
+			agents.pop_back();
+			_pool.destroy(agent);
+		}
+
+	public:
+		RVO::Simulator simulator;
+		std::vector<BenchAgent*> agents;
+
+	private:
+		Pool<BenchAgent> _pool;
+	};
+
+
+	inline void steerToGoal(BenchAgent* agent)
+	{
+		vec2 toGoal = agent->goal - agent->position;
+		float distance = length(toGoal);
+		agent->prefVelocity = distance > agent->maxSpeed ? toGoal * (agent->maxSpeed / distance) : toGoal;
+	}
+
+
+	struct Options
+	{
+		bool lod;
+		// stream agents share a flow field instead of steering straight at the target
+		bool flow;
+		bool noReorder;
+		bool noAlloc;
+		// null runs the simulation on the main thread
+		JobSystem* jobs;
+	};
+
+
+	class Scenario
+	{
+	public:
+		Scenario() : options() {}
+		virtual ~Scenario() {}
+		virtual const char* getName() const = 0;
+		virtual void setup(Crowd& crowd, size_t agentsCount, std::mt19937& random) = 0;
+		virtual void preStep(Crowd& crowd, size_t step, std::mt19937& random) = 0;
+
+	public:
+		Options options;
+	};
+
+
+	// agents are placed on concentric rings and swap with the antipodal point
+	class CircleScenario : public Scenario
+	{
+	public:
+		virtual const char* getName() const { return "circle"; }
+
+		virtual void setup(Crowd& crowd, size_t agentsCount, std::mt19937& /*random*/)
+		{
+			const float spacing = 4.0f;
+			float ringRadius = 100.0f;
+			size_t placed = 0;
+			while (placed < agentsCount)
+			{
+				size_t ringCapacity = (size_t)(2.0f * (float)M_PI * ringRadius / spacing);
+				size_t ringCount = std::min(ringCapacity, agentsCount - placed);
+				for (size_t i = 0; i < ringCount; ++i)
+				{
+					float angle = 2.0f * (float)M_PI * i / ringCount;
+					vec2 position(cosf(angle) * ringRadius, sinf(angle) * ringRadius);
+					crowd.add(position, -position);
+				}
+				placed += ringCount;
+				ringRadius += spacing;
+			}
+		}
+
+		virtual void preStep(Crowd& crowd, size_t /*step*/, std::mt19937& /*random*/)
+		{
+			for (size_t i = 0; i < crowd.agents.size(); ++i)
+				steerToGoal(crowd.agents[i]);
+		}
+	};
+
+
+	// four square blocks walk through each other to the opposite side
+	class CrossingScenario : public Scenario
+	{
+	public:
+		virtual const char* getName() const { return "crossing"; }
+
+		virtual void setup(Crowd& crowd, size_t agentsCount, std::mt19937& /*random*/)
+		{
+			const float spacing = 4.0f;
+			size_t groupCount = (agentsCount + 3) / 4;
+			size_t side = (size_t)ceilf(sqrtf((float)groupCount));
+			float blockSize = side * spacing;
+			float offset = blockSize + 50.0f;
+			const vec2 directions[4] = { vec2(1, 0), vec2(-1, 0), vec2(0, 1), vec2(0, -1) };
+			for (size_t i = 0; i < agentsCount; ++i)
+			{
+				size_t group = i % 4;
+				size_t slot = i / 4;
+				vec2 direction = directions[group];
+				vec2 across(-direction.y, direction.x);
+				float along = (slot / side) * spacing;
+				float aside = (slot % side) * spacing - 0.5f * blockSize;
+				vec2 position = direction * -(offset + along) + across * aside;
+				crowd.add(position, direction * (offset + along) + across * aside);
+			}
+		}
+
+		virtual void preStep(Crowd& crowd, size_t /*step*/, std::mt19937& /*random*/)
+		{
+			for (size_t i = 0; i < crowd.agents.size(); ++i)
+				steerToGoal(crowd.agents[i]);
+		}
+	};
+
+
+	// what Spawner and Nazi do: agents keep pouring from one edge and chase a moving target,
+	// the ones which reach it are killed and respawned
+	class StreamScenario : public Scenario
+	{
+	public:
+		StreamScenario() : _flowField(nullptr) {}
+		~StreamScenario() { delete _flowField; }
+
+		virtual const char* getName() const { return "stream"; }
+
+		virtual void setup(Crowd& crowd, size_t agentsCount, std::mt19937& random)
+		{
+			_fieldSize = std::max(100.0f, 2.5f * sqrtf((float)agentsCount) * 4.0f);
+			delete _flowField;
+			_flowField = nullptr;
+			if (options.flow)
+			{
+				const float cellSize = 4.0f;
+				size_t cells = (size_t)ceilf(2.0f * _fieldSize / cellSize) + 1;
+				_flowField = new RVO::FlowField(vec2(-_fieldSize, -_fieldSize), cellSize, cells, cells);
+				crowd.simulator.addFlowField(_flowField);
+			}
+
+			std::uniform_real_distribution<float> coordinate(-_fieldSize, _fieldSize);
+			for (size_t i = 0; i < agentsCount; ++i)
+				spawn(crowd, vec2(coordinate(random), coordinate(random)));
+		}
+
+		virtual void preStep(Crowd& crowd, size_t step, std::mt19937& random)
+		{
+			float angle = 0.01f * step;
+			vec2 target(cosf(angle) * 0.5f * _fieldSize, sinf(angle) * 0.5f * _fieldSize);
+			std::uniform_real_distribution<float> coordinate(-_fieldSize, _fieldSize);
+			if (_flowField != nullptr)
+				_flowField->setGoal(target);
+
+			size_t killed = 0;
+			for (size_t i = 0; i < crowd.agents.size(); ++i)
+			{
+				BenchAgent* agent = crowd.agents[i];
+				if (length2(target - agent->position) < 4.0f)
+				{
+					crowd.remove(i--);
+					++killed;
+				}
+				else if (_flowField == nullptr)
+				{
+					agent->prefVelocity = target - agent->position;
+				}
+			}
+
+			for (size_t i = 0; i < killed; ++i)
+				spawn(crowd, vec2(-_fieldSize, coordinate(random)));
+		}
+
+	private:
+		void spawn(Crowd& crowd, const vec2& position)
+		{
+			BenchAgent* agent = crowd.add(position, vec2(0, 0));
+			agent->flowField = _flowField;
+		}
+
+	private:
+		float _fieldSize;
+		RVO::FlowField* _flowField;
+	};
+
+
+	// a settled crowd: agents stand on a jittered grid with nowhere to go, a few walkers cross it
+	class IdleScenario : public Scenario
+	{
+	public:
+		virtual const char* getName() const { return "idle"; }
+
+		virtual void setup(Crowd& crowd, size_t agentsCount, std::mt19937& random)
+		{
+			const float spacing = 6.0f;
+			size_t side = (size_t)ceilf(sqrtf((float)agentsCount));
+			_fieldSize = side * spacing;
+			std::uniform_real_distribution<float> jitter(-1.0f, 1.0f);
+			for (size_t i = 0; i < agentsCount; ++i)
+			{
+				vec2 position((i % side) * spacing + jitter(random), (i / side) * spacing + jitter(random));
+				crowd.add(position, position);
+			}
+		}
+
+		virtual void preStep(Crowd& crowd, size_t step, std::mt19937& /*random*/)
+		{
+			// one walker per 1024 agents keeps going across the field and back
+			size_t walkersCount = crowd.agents.size() / 1024 + 1;
+			for (size_t i = 0; i < walkersCount; ++i)
+			{
+				BenchAgent* walker = crowd.agents[i * (crowd.agents.size() / walkersCount)];
+				walker->goal = (step / 200) % 2 == 0 ? vec2(_fieldSize, walker->goal.y) : vec2(0, walker->goal.y);
+				steerToGoal(walker);
+			}
+		}
+
+	private:
+		float _fieldSize;
+	};
+
+
+	struct Result
+	{
+		double build;
+		double query;
+		double solve;
+		// over the measured steps
+		Spatial::QueryCounters counters;
+		uint64_t allocations;
+	};
+
+	Result run(Scenario& scenario, size_t agentsCount, size_t steps)
+	{
+		std::mt19937 random(1337);
+		Crowd crowd(BENCH_INITIAL_CAPACITY);
+		scenario.setup(crowd, agentsCount, random);
+		if (scenario.options.noReorder)
+			crowd.simulator.setReorderPeriod(0);
+		crowd.simulator.setJobSystem(scenario.options.jobs);
+		if (scenario.options.lod)
+		{
+			// the tiers main.js uses, focused on the origin
+			crowd.simulator.setLodFocus(vec2(0, 0));
+			crowd.simulator.setLodLevel(1, 150.0f, 2, 4, false);
+			crowd.simulator.setLodLevel(2, 300.0f, 4, 0, true);
+		}
+
+		Result result;
+		result.build = 0;
+		result.query = 0;
+		result.solve = 0;
+		result.allocations = 0;
+		AllocationTracker& tracker = AllocationTracker::getInstance();
+		if (scenario.options.noAlloc)
+			tracker.setSamplePeriod(1);
+		RVO::Simulator& simulator = crowd.simulator;
+		BenchNeighborIndex index;
+		simulator.setNeighborIndex(&index);
+		for (size_t step = 0; step < BENCH_WARMUP_STEPS + steps; ++step)
+		{
+			tracker.beginFrame();
+			scenario.preStep(crowd, step, random);
+			if (step == BENCH_WARMUP_STEPS)
+				Spatial::collectQueryCounters();
+
+			// the same phases doStep runs
+			Clock::time_point buildStart = Clock::now();
+			simulator.prepareStep();
+			index.build(crowd.agents);
+			Clock::time_point queryStart = Clock::now();
+			simulator.queryNeighbors();
+			Clock::time_point solveStart = Clock::now();
+			simulator.computeNewVelocities(BENCH_TIME_STEP);
+			simulator.applyNewVelocities(BENCH_TIME_STEP);
+			Clock::time_point solveEnd = Clock::now();
+
+			// the step becomes the tracker's last frame
+			tracker.beginFrame();
+			if (step >= BENCH_WARMUP_STEPS && tracker.getFrameCounters().count > 0)
+			{
+				if (result.allocations == 0 && scenario.options.noAlloc)
+				{
+					printf("step %u after the warm-up allocates:\n", (unsigned)(step - BENCH_WARMUP_STEPS));
+					tracker.report(stdout);
+				}
+				result.allocations += tracker.getFrameCounters().count;
+			}
+
+			if (step >= BENCH_WARMUP_STEPS)
+			{
+				result.build += std::chrono::duration<double, std::milli>(queryStart - buildStart).count();
+				result.query += std::chrono::duration<double, std::milli>(solveStart - queryStart).count();
+				result.solve += std::chrono::duration<double, std::milli>(solveEnd - solveStart).count();
+			}
+		}
+
+		result.counters = Spatial::collectQueryCounters();
+		result.build /= steps;
+		result.query /= steps;
+		result.solve /= steps;
+		return result;
+	}
+
+}
+
+int main(int argc, char** argv)
+{
+	CircleScenario circle;
+	CrossingScenario crossing;
+	StreamScenario stream;
+	IdleScenario idle;
+	Scenario* scenarios[] = { &circle, &crossing, &stream, &idle };
+	const size_t scenariosCount = sizeof(scenarios) / sizeof(scenarios[0]);
+	size_t agentCounts[] = { 256, 1024, 4096, 16384, 50000 };
+	size_t agentCountsCount = sizeof(agentCounts) / sizeof(agentCounts[0]);
+
+	const char* scenarioFilter = argc > 1 ? argv[1] : "all";
+	if (argc > 2 && strcmp(argv[2], "all") != 0)
+	{
+		agentCounts[0] = (size_t)atol(argv[2]);
+		agentCountsCount = 1;
+	}
+	size_t steps = argc > 3 ? (size_t)atol(argv[3]) : BENCH_DEFAULT_STEPS;
+	if (steps == 0)
+		steps = 1;
+	Options options = { false, false, false, false, nullptr };
+	bool jobs = false;
+	for (int i = 4; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "lod") == 0)
+			options.lod = true;
+		else if (strcmp(argv[i], "flow") == 0)
+			options.flow = true;
+		else if (strcmp(argv[i], "noreorder") == 0)
+			options.noReorder = true;
+		else if (strcmp(argv[i], "noalloc") == 0)
+			options.noAlloc = true;
+		else if (strcmp(argv[i], "jobs") == 0)
+			jobs = true;
+	}
+#if !defined(FIRSTBLOOD_TRACK_ALLOCATIONS)
+	if (options.noAlloc)
+	{
+		fprintf(stderr, "noalloc needs a build with FIRSTBLOOD_TRACK_ALLOCATIONS\n");
+		return 1;
+	}
+#endif
+	bool allocated = false;
+	JobSystem* jobSystem = jobs ? new JobSystem() : nullptr;
+	options.jobs = jobSystem;
+	if (jobSystem != nullptr)
+		printf("%u worker threads\n", (unsigned)jobSystem->getWorkersCount());
+
+	printf("%-10s %8s %8s %10s %10s %10s %10s\n", "scenario", "agents", "steps", "total ms", "build ms", "query ms", "solve ms");
+	bool anyScenario = false;
+	for (size_t i = 0; i < scenariosCount; ++i)
+	{
+		Scenario& scenario = *scenarios[i];
+		if (strcmp(scenarioFilter, "all") != 0 && strcmp(scenarioFilter, scenario.getName()) != 0)
+			continue;
+		anyScenario = true;
+		scenario.options = options;
+		for (size_t j = 0; j < agentCountsCount; ++j)
+		{
+			Result result = run(scenario, agentCounts[j], steps);
+			printf("%-10s %8u %8u %10.3f %10.3f %10.3f %10.3f\n", scenario.getName(), (unsigned)agentCounts[j], (unsigned)steps,
+				result.build + result.query + result.solve, result.build, result.query, result.solve);
+			if (options.noAlloc && result.allocations > 0)
+			{
+				printf("%10s %llu allocations after the warm-up\n", "", (unsigned long long)result.allocations);
+				allocated = true;
+			}
+#if defined(SPATIAL_QUERY_COUNTERS)
+			const uint64_t* counters = result.counters.values;
+			double queries = (double)std::max<uint64_t>(counters[Spatial::counterNeighbourQueries], 1);
+			printf("%10s queries/step %.0f  nodes/q %.1f  pruned/q %.1f  tested/q %.1f  hits/q %.1f  arena %.0f KB\n", "",
+				queries / steps, counters[Spatial::counterNodesVisited] / queries, counters[Spatial::counterSubtreesPruned] / queries,
+				counters[Spatial::counterInhabitantsTested] / queries, counters[Spatial::counterHits] / queries,
+				counters[Spatial::counterArenaBytes] / 1024.0 / steps);
+#endif
+			fflush(stdout);
+		}
+	}
+
+	if (!anyScenario)
+	{
+		fprintf(stderr, "unknown scenario: %s (expected circle, crossing, stream, idle or all)\n", scenarioFilter);
+		delete jobSystem;
+		return 1;
+	}
+	delete jobSystem;
+	return allocated ? 1 : 0;
+}
@@ -43,14 +43,40 @@ var dynamicLibraries = {
 	]
 };
 
+// headless benchmarks: link only engine-independent modules, no inanity libraries
+var benchmarks = {
+	rvo_bench: ['bench.rvo_bench', 'rvo.simulator', 'rvo.agent', 'rvo.math', 'rvo.flow_field', 'profiler.scope_profiler', 'memory.allocation_tracker', 'jobs.job_system'],
+	pool_bench: ['bench.pool_bench']
+};
+// benchmarks of engine parts: link inanity libraries like the game, but only these objects
+var engineBenchmarks = {
+	painter_bench: ['bench.painter_bench', 'Painter', 'RecordingPainter', 'GeometryFormats']
+};
+var benchmarkDynamicLibraries = {
+	win32: [],
+	linux: ['pthread']
+};
+
 exports.configureLinker = function(executableFile, linker) {
-	var a = /^(([^\/]+)\/)[^\/]+$/.exec(executableFile);
+	var a = /^(([^\/]+)\/)([^\/]+)$/.exec(executableFile);
 	linker.configuration = a[2];
 
-	var objects = [
-		'main', 'Engine', 'Game', 'Geometry', 'GeometryFormats', 'Painter', 
-		'rvo.simulator', 'rvo.agent', 'rvo.math', 'gamelogic.rvo', 
-		'script.system', 'script.utils', 'script.bindings', 'script.time', 'script.spatial', 'script.camera', 'script.input'
+	var benchmarkObjects = benchmarks[a[3]];
+	if(benchmarkObjects) {
+		for(var i = 0; i < benchmarkObjects.length; ++i)
+			linker.addObjectFile(a[1] + benchmarkObjects[i]);
+		var bdl = benchmarkDynamicLibraries[linker.platform];
+		for(var i = 0; i < bdl.length; ++i)
+			linker.addDynamicLibrary(bdl[i]);
+		return;
+	}
+
+	var objects = engineBenchmarks[a[3]] || [
+		'main', 'Engine', 'Game', 'Geometry', 'GeometryFormats', 'Painter', 'DevicePainter', 'AssetLoader',
+		'rvo.simulator', 'rvo.agent', 'rvo.math', 'rvo.flow_field', 'gamelogic.rvo', 'gamelogic.spatial_registry',
+		'script.system', 'script.code_cache', 'script.utils', 'script.bindings', 'script.time', 'script.spatial', 'script.camera', 'script.input', 'script.profiler',
+		'profiler.scope_profiler', 'profiler.trace_capture', 'profiler.frame_stats', 'memory.allocation_tracker',
+		'jobs.job_system'
 	];
 	for ( var i = 0; i < objects.length; ++i)
 		linker.addObjectFile(a[1] + objects[i]);
@@ -3,14 +3,24 @@
 
 #include "rvo/interfaces.hpp"
 #include "rvo/agent.hpp"
-#include "memory/pool_allocator.hpp"
+#include "memory/concurrent_pool.hpp"
 
 namespace Firstblood
 {
 
+	// concrete type of an indexed entity, so queries can cast what they find without a virtual call
+	enum SpatialEntityType
+	{
+		spatialEntityOther,
+		spatialEntityRvoAgent
+	};
+
+
 	class ISpatiallyIndexable
 	{
 	public:
+		ISpatiallyIndexable(SpatialEntityType type = spatialEntityOther) : uid(0), type(type) {}
+
 		virtual bool raycast(const vec3& origin, const vec3& end, float& dist) = 0;
 		virtual float getRadius() = 0;
 		virtual vec3 getPosition() = 0;
@@ -19,6 +29,19 @@ namespace Firstblood
 	
 	public:
 		int uid;
+		SpatialEntityType type;
+	};
+
+
+	// subsystem owning spatially indexable entities, registered in SpatialRegistry
+	class ISpatialProvider
+	{
+	public:
+		virtual ~ISpatialProvider() {}
+		// exactly as many entities as the next collectSpatialData writes
+		virtual size_t getSpatialCount() = 0;
+		// writes getSpatialCount() entities, runs in parallel with other providers
+		virtual void collectSpatialData(ISpatiallyIndexable** entities) = 0;
 	};
 
 }
@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <cstdlib>
 #include <assert.h>
 #include "gamelogic/rvo.hpp"
 #include "rvo/simulator.hpp"
@@ -8,97 +9,214 @@
 namespace Firstblood
 {
 
-	/** Rvo agent **/
-	void RvoAgent::FreeAsNotReferenced() {}
+	/** Rvo flow field **/
+	RvoFlowField::RvoFlowField(const vec2& origin, float cellSize, size_t width, size_t height) : RVO::FlowField(origin, cellSize, width, height) {}
 
-	void RvoAgent::setMaxNeighbors(int value)
+	void RvoFlowField::setGoal(const vec2& goal)
 	{
-		maxNeighbors = value;
+		RVO::FlowField::setGoal(goal);
 	}
 
-	void RvoAgent::setMask(uint32_t mask)
+	void RvoFlowField::setBlocked(const vec2& min, const vec2& max, bool blocked)
 	{
-		this->mask = mask;
+		RVO::FlowField::setBlocked(min, max, blocked);
 	}
 
-	void RvoAgent::setImmobilized(bool value)
+
+	/** Rvo simulation **/
+	RvoSimulation::RvoSimulation(size_t initialCapacity) : RVO::Simulator(initialCapacity), _slotsCount(0), _freeSlotsHead(RVO_NO_SLOT),
+		_addedHead(RVO_NO_SLOT), _removedHead(RVO_NO_SLOT), _spatialIndex(nullptr)
 	{
-		immobilized = value;
+		_agentsPool = new ConcurrentPool<RvoAgent>(initialCapacity);
+		for (size_t i = 0; i < RVO_SLOT_CHUNKS_COUNT; ++i)
+			_slotChunks[i].store(nullptr, std::memory_order_relaxed);
 	}
 
-	void RvoAgent::setTimeHorizon(float horizon)
+	RvoSimulation::~RvoSimulation()
 	{
-		timeHorizon = horizon;
+		for (size_t i = 0; i < RVO_SLOT_CHUNKS_COUNT; ++i)
+			delete [] _slotChunks[i].load();
+		delete _agentsPool;
 	}
 
-	float RvoAgent::getMaxSpeed()
+	RvoAgentHandle RvoSimulation::create(const vec2& position, int uid)
 	{
-		return maxSpeed;
+		RvoAgent* agent = _agentsPool->create();
+		applyDefaultsToAgent(agent);
+		agent->position = position;
+		agent->uid = uid;
+
+		uint32_t index = allocSlot();
+		AgentSlot* slot = getSlot(index);
+		slot->agent.store(agent, std::memory_order_release);
+		pushRequest(_addedHead, &AgentSlot::nextAdded, index);
+		return (slot->state.load(std::memory_order_relaxed) << RVO_HANDLE_INDEX_BITS) | index;
 	}
 
-	void RvoAgent::setMaxSpeed(float value)
+	void RvoSimulation::destroy(RvoAgentHandle handle)
 	{
-		maxSpeed = value;
+		uint32_t generation = handle >> RVO_HANDLE_INDEX_BITS;
+		AgentSlot* slot = getSlot(handle & RVO_HANDLE_INDEX_MASK);
+		if (slot == nullptr || generation == 0 || generation > RVO_HANDLE_GENERATION_MASK)
+			return;
+		// only the first destroy of a live handle marks the slot and queues the removal
+		if (!slot->state.compare_exchange_strong(generation, generation | RVO_HANDLE_TOMBSTONE, std::memory_order_relaxed))
+			return;
+		pushRequest(_removedHead, &AgentSlot::nextRemoved, handle & RVO_HANDLE_INDEX_MASK);
 	}
 
-	void RvoAgent::setPrefVelocity(const vec2& velocity)
+	bool RvoSimulation::isAlive(RvoAgentHandle handle)
 	{
-		prefVelocity = velocity;
+		return getAgent(handle) != nullptr && !(getSlot(handle & RVO_HANDLE_INDEX_MASK)->state.load(std::memory_order_relaxed) & RVO_HANDLE_TOMBSTONE);
 	}
 
+	RvoAgent* RvoSimulation::getAgent(RvoAgentHandle handle)
+	{
+		AgentSlot* slot = getSlot(handle & RVO_HANDLE_INDEX_MASK);
+		if (slot == nullptr || (slot->state.load(std::memory_order_acquire) & RVO_HANDLE_GENERATION_MASK) != (handle >> RVO_HANDLE_INDEX_BITS))
+			return nullptr;
+		return slot->agent.load(std::memory_order_acquire);
+	}
 
-	/** Rvo simulation **/
-	RvoSimulation::RvoSimulation(size_t maxAgents, Spatial::IIndex2D<ISpatiallyIndexable>* spatialIndex) : _spatialIndex(spatialIndex), RVO::Simulator(maxAgents)
+	RvoSimulation::AgentSlot* RvoSimulation::getSlot(uint32_t index) const
 	{
-		_allocator = new PoolAllocator(sizeof(RvoAgent), maxAgents);
+		AgentSlot* chunk = _slotChunks[index >> RVO_SLOT_CHUNK_BITS].load(std::memory_order_acquire);
+		return chunk != nullptr ? chunk + (index & (RVO_SLOT_CHUNK_SIZE - 1)) : nullptr;
 	}
 
-	RvoSimulation::~RvoSimulation()
+	uint32_t RvoSimulation::allocSlot()
 	{
-		delete _allocator;
+		uint64_t head = _freeSlotsHead.load(std::memory_order_acquire);
+		while ((uint32_t)head != RVO_NO_SLOT)
+		{
+			uint32_t index = (uint32_t)head;
+			// the slot may be taken and freed again meanwhile, then the tag check fails and the read link is dropped
+			uint32_t next = getSlot(index)->nextFree.load(std::memory_order_relaxed);
+			if (_freeSlotsHead.compare_exchange_weak(head, ((head >> 32) + 1) << 32 | next, std::memory_order_acquire, std::memory_order_acquire))
+				return index;
+		}
+
+		uint32_t index = _slotsCount.fetch_add(1, std::memory_order_relaxed);
+		// handles can't address more slots, going on would hand out handles of other agents
+		assert(index <= RVO_HANDLE_INDEX_MASK);
+		if (index > RVO_HANDLE_INDEX_MASK)
+			abort();
+		std::atomic<AgentSlot*>& chunk = _slotChunks[index >> RVO_SLOT_CHUNK_BITS];
+		if (chunk.load(std::memory_order_acquire) == nullptr)
+		{
+			AgentSlot* slots = new AgentSlot[RVO_SLOT_CHUNK_SIZE];
+			for (size_t i = 0; i < RVO_SLOT_CHUNK_SIZE; ++i)
+			{
+				slots[i].agent.store(nullptr, std::memory_order_relaxed);
+				slots[i].state.store(1, std::memory_order_relaxed);
+				slots[i].nextFree.store(RVO_NO_SLOT, std::memory_order_relaxed);
+				slots[i].nextAdded.store(RVO_NO_SLOT, std::memory_order_relaxed);
+				slots[i].nextRemoved.store(RVO_NO_SLOT, std::memory_order_relaxed);
+			}
+			// threads taking slots of a new chunk at once race to add it, the losers drop theirs
+			AgentSlot* expected = nullptr;
+			if (!chunk.compare_exchange_strong(expected, slots, std::memory_order_acq_rel))
+				delete [] slots;
+		}
+		return index;
 	}
 
-	ptr<RvoAgent> RvoSimulation::create(const vec2& position, int uid)
+	void RvoSimulation::freeSlot(uint32_t index)
 	{
-		void* agentMemory = _allocator->allocMemory(sizeof(RvoAgent));
-		RvoAgent* agent = new (agentMemory) RvoAgent;
-		applyDefaultsToAgent(agent);
-		agent->position = position;
-		agent->uid = uid;
-		toBeAddedQueue.push_back(agent);
-		return agent;
+		AgentSlot* slot = getSlot(index);
+		slot->agent.store(nullptr, std::memory_order_relaxed);
+		// a wrapped generation would make stale handles valid again, so a slot with the last generation is retired:
+		// it keeps the tombstone and never gets to the free list
+		uint32_t generation = slot->state.load(std::memory_order_relaxed) & RVO_HANDLE_GENERATION_MASK;
+		if (generation == RVO_HANDLE_GENERATION_MASK)
+			return;
+		slot->state.store(generation + 1, std::memory_order_release);
+		uint64_t head = _freeSlotsHead.load(std::memory_order_relaxed);
+		do
+		{
+			slot->nextFree.store((uint32_t)head, std::memory_order_relaxed);
+		}
+		while (!_freeSlotsHead.compare_exchange_weak(head, ((head >> 32) + 1) << 32 | index, std::memory_order_release, std::memory_order_relaxed));
 	}
 
-	void RvoSimulation::destroy(ptr<RvoAgent> agent)
+	void RvoSimulation::pushRequest(std::atomic<uint32_t>& head, std::atomic<uint32_t> AgentSlot::* link, uint32_t index)
 	{
-		for (size_t i = 0; i < toBeRemovedQueue.size(); ++i)
-			if (toBeRemovedQueue[i] == (RvoAgent*)agent)
+		AgentSlot* slot = getSlot(index);
+		uint32_t next = head.load(std::memory_order_relaxed);
+		do
+		{
+			(slot->*link).store(next, std::memory_order_relaxed);
+		}
+		while (!head.compare_exchange_weak(next, index, std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	void RvoSimulation::takeRequests(std::atomic<uint32_t>& head, std::atomic<uint32_t> AgentSlot::* link, std::vector<uint32_t>& slots)
+	{
+		slots.clear();
+		for (uint32_t index = head.exchange(RVO_NO_SLOT, std::memory_order_acquire); index != RVO_NO_SLOT; index = (getSlot(index)->*link).load(std::memory_order_relaxed))
+			slots.push_back(index);
+		std::reverse(slots.begin(), slots.end());
+	}
+
+	ptr<RvoFlowField> RvoSimulation::createFlowField(const vec2& origin, float cellSize, size_t width, size_t height)
+	{
+		ptr<RvoFlowField> field = NEW(RvoFlowField(origin, cellSize, width, height));
+		_flowFieldsOwned.push_back(field);
+		addFlowField(field);
+		return field;
+	}
+
+	void RvoSimulation::destroyFlowField(ptr<RvoFlowField> field)
+	{
+		for (size_t i = 0; i < _flowFieldsOwned.size(); ++i)
+		{
+			if ((RvoFlowField*)_flowFieldsOwned[i] == (RvoFlowField*)field)
+			{
+				removeFlowField(field);
+				// agents created this frame are not in the simulator yet, the list is only taken on this thread
+				for (uint32_t index = _addedHead.load(std::memory_order_acquire); index != RVO_NO_SLOT; index = getSlot(index)->nextAdded.load(std::memory_order_relaxed))
+				{
+					RvoAgent* agent = getSlot(index)->agent.load(std::memory_order_relaxed);
+					if (agent->flowField == (RvoFlowField*)field)
+						agent->flowField = nullptr;
+				}
+				ScriptSystem::getInstance()->removeFromScript(field);
+				_flowFieldsOwned[i] = _flowFieldsOwned.back();
+				_flowFieldsOwned.pop_back();
 				return;
-		toBeRemovedQueue.push_back(agent);
+			}
+		}
 	}
 
 	void RvoSimulation::update(float dt)
 	{
-		doStep(dt, this);
+		doStep(dt);
 	}
 
 	void RvoSimulation::postUpdate()
 	{
-		ScriptSystem* scripts = ScriptSystem::getInstance();
-		for (size_t i = 0; i < toBeRemovedQueue.size(); ++i)
-		{
-			RvoAgent* agent = toBeRemovedQueue[i];
-			scripts->removeFromScript(agent);
-			removeAgent(agent);
-			_allocator->dealloc(agent);
-		}
-		toBeRemovedQueue.clear();
+		// removals are taken first: an agent is created before it can be destroyed, so every agent being removed
+		// is either added already or among the additions taken next, even if requests keep coming from other threads
+		takeRequests(_removedHead, &AgentSlot::nextRemoved, _removedSlots);
+		takeRequests(_addedHead, &AgentSlot::nextAdded, _addedSlots);
+
+		// agents created and destroyed within the same frame are added first, so that removal finds them
+		for (size_t i = 0; i < _addedSlots.size(); ++i)
+			addAgent(getSlot(_addedSlots[i])->agent.load(std::memory_order_relaxed));
+
+		if (_removedSlots.empty())
+			return;
 
-		for (size_t i = 0; i < toBeAddedQueue.size(); ++i)
+		_removedAgents.clear();
+		for (size_t i = 0; i < _removedSlots.size(); ++i)
+			_removedAgents.push_back(getSlot(_removedSlots[i])->agent.load(std::memory_order_relaxed));
+		removeAgents(&_removedAgents[0], _removedAgents.size());
+
+		for (size_t i = 0; i < _removedSlots.size(); ++i)
 		{
-			addAgent(toBeAddedQueue[i]);
+			_agentsPool->destroy(static_cast<RvoAgent*>(_removedAgents[i]));
+			freeSlot(_removedSlots[i]);
 		}
-		toBeAddedQueue.clear();
 	}
 
 	void RvoSimulation::setAgentDefaults(float neighborDist, size_t maxNeighbors, float timeHorizon, float radius, float maxSpeed)
@@ -116,28 +234,119 @@ namespace Firstblood
 		return RVO::Simulator::getNumAgents();
 	}
 
-	size_t RvoSimulation::collectSpatialData(ISpatiallyIndexable** list, size_t maxSize)
+	void RvoSimulation::setLodFocus(const vec2& focus)
 	{
-		size_t amount = std::min(maxSize, _agentsCount);
-		for (size_t i = 0; i < amount; ++i)
-			*(list + i) = static_cast<RvoAgent*>(_agents[i]);
-		return amount;
+		RVO::Simulator::setLodFocus(focus);
 	}
 
-	size_t RvoSimulation::find(RVO::Agent* agent, RVO::NeighborEntity* result, size_t maxResultLength)
+	void RvoSimulation::setLodLevel(size_t level, float minDistance, size_t updatePeriod, size_t maxNeighbors, bool steeringOnly)
 	{
-		RvoAgent* ourAgent = static_cast<RvoAgent*>(agent);
-		Spatial::NearestNeighbor<ISpatiallyIndexable> intermediateResult[RVO_GET_NEAREST_AGENTS_MAX_BUFFER_SIZE];
-		size_t count = _spatialIndex->getNeighbours(vec3(agent->position.x, agent->position.y, 0), agent->neighborDist, agent->mask, &intermediateResult[0], maxResultLength, ourAgent);
-		for (size_t i = 0; i < count; ++i)
-		{
-			ISpatiallyIndexable* intermediateNeighbor = intermediateResult[i].entity;
-			RVO::NeighborEntity* neighbor = result + i;
-			vec3 neighborPosition = intermediateNeighbor->getPosition();
-			neighbor->position = vec2(neighborPosition.x, neighborPosition.y);
-			neighbor->radius = intermediateNeighbor->getRadius();
-			neighbor->velocity = intermediateNeighbor->getVelocity();
-		}
+		RVO::Simulator::setLodLevel(level, minDistance, updatePeriod, maxNeighbors, steeringOnly);
+	}
+
+	vec2 RvoSimulation::getPosition(RvoAgentHandle handle)
+	{
+		RvoAgent* agent = getAgent(handle);
+		return agent != nullptr ? agent->position : vec2(0, 0);
+	}
+
+	float RvoSimulation::getRadius(RvoAgentHandle handle)
+	{
+		RvoAgent* agent = getAgent(handle);
+		return agent != nullptr ? agent->radius : 0.0f;
+	}
+
+	uint32_t RvoSimulation::getMask(RvoAgentHandle handle)
+	{
+		RvoAgent* agent = getAgent(handle);
+		return agent != nullptr ? agent->mask : 0;
+	}
+
+	void RvoSimulation::setMask(RvoAgentHandle handle, uint32_t mask)
+	{
+		if (RvoAgent* agent = getAgent(handle))
+			agent->mask = mask;
+	}
+
+	void RvoSimulation::setMaxNeighbors(RvoAgentHandle handle, int value)
+	{
+		if (RvoAgent* agent = getAgent(handle))
+			agent->maxNeighbors = value;
+	}
+
+	void RvoSimulation::setImmobilized(RvoAgentHandle handle, bool value)
+	{
+		if (RvoAgent* agent = getAgent(handle))
+			agent->immobilized = value;
+	}
+
+	void RvoSimulation::setTimeHorizon(RvoAgentHandle handle, float horizon)
+	{
+		if (RvoAgent* agent = getAgent(handle))
+			agent->timeHorizon = horizon;
+	}
+
+	float RvoSimulation::getMaxSpeed(RvoAgentHandle handle)
+	{
+		RvoAgent* agent = getAgent(handle);
+		return agent != nullptr ? agent->maxSpeed : 0.0f;
+	}
+
+	void RvoSimulation::setMaxSpeed(RvoAgentHandle handle, float value)
+	{
+		if (RvoAgent* agent = getAgent(handle))
+			agent->maxSpeed = value;
+	}
+
+	void RvoSimulation::setPrefVelocity(RvoAgentHandle handle, const vec2& velocity)
+	{
+		RvoAgent* agent = getAgent(handle);
+		if (agent == nullptr)
+			return;
+		agent->prefVelocity = velocity;
+		// scripts often keep setting zero velocity to stopped agents, which shouldn't disturb them
+		if (length2(velocity) > sqr(RVO_SLEEP_SPEED))
+			agent->wake();
+	}
+
+	void RvoSimulation::setFlowField(RvoAgentHandle handle, ptr<RvoFlowField> field)
+	{
+		RvoAgent* agent = getAgent(handle);
+		if (agent == nullptr)
+			return;
+		// the field is kept alive by the simulation until destroyFlowField
+		agent->flowField = field;
+		agent->wake();
+	}
+
+	size_t RvoSimulation::getSpatialCount()
+	{
+		return _agentsCount;
+	}
+
+	void RvoSimulation::collectSpatialData(ISpatiallyIndexable** entities)
+	{
+		for (size_t i = 0; i < _agentsCount; ++i)
+			entities[i] = static_cast<RvoAgent*>(_agents[i]);
+	}
+
+	void RvoSimulation::setSpatialIndex(Spatial::IIndex2D<ISpatiallyIndexable>* index)
+	{
+		_spatialIndex = index;
+		setNeighborIndex(index != nullptr ? this : nullptr);
+	}
+
+	size_t RvoSimulation::getNeighborAgents(const RVO::Agent* agent, float distance, uint32_t* result, size_t maxResultLength) const
+	{
+		// all agents of the simulation are RvoAgents
+		RvoAgent* self = const_cast<RvoAgent*>(static_cast<const RvoAgent*>(agent));
+		Spatial::NearestNeighbor<ISpatiallyIndexable> found[RVO_GET_NEAREST_AGENTS_MAX_BUFFER_SIZE];
+		size_t foundCount = _spatialIndex->getNeighbours(vec3(agent->position.x, agent->position.y, 0), distance, agent->mask, found,
+			std::min(maxResultLength, RVO_GET_NEAREST_AGENTS_MAX_BUFFER_SIZE), self);
+		size_t count = 0;
+		for (size_t i = 0; i < foundCount; ++i)
+			if (found[i].entity->type == spatialEntityRvoAgent)
+				result[count++] = (uint32_t)static_cast<RvoAgent*>(found[i].entity)->getIndex();
 		return count;
 	}
 
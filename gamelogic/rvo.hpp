@@ -3,55 +3,78 @@
 
 #include <vector>
 #include <unordered_set>
+#include <atomic>
 #include "inanity/script/v8/State.hpp"
 #include "inanity/meta/decl.hpp"
 #include "inanity/ptr.hpp"
 #include "gamelogic/common.hpp"
+#include "spatial/interfaces.hpp"
 #include "rvo/interfaces.hpp"
 #include "rvo/simulator.hpp"
+#include "rvo/flow_field.hpp"
+
+#define RVO_HANDLE_INDEX_BITS 20
+#define RVO_HANDLE_INDEX_MASK ((1u << RVO_HANDLE_INDEX_BITS) - 1)
+// generation takes the rest but the top bit, so that handles stay positive in scripts
+#define RVO_HANDLE_GENERATION_MASK ((1u << (31 - RVO_HANDLE_INDEX_BITS)) - 1)
+#define RVO_HANDLE_TOMBSTONE (1u << 31)
+// slots are allocated by chunks which never move, so that handles are resolved without a lock
+#define RVO_SLOT_CHUNK_BITS 10
+#define RVO_SLOT_CHUNK_SIZE (1u << RVO_SLOT_CHUNK_BITS)
+#define RVO_SLOT_CHUNKS_COUNT (1u << (RVO_HANDLE_INDEX_BITS - RVO_SLOT_CHUNK_BITS))
+#define RVO_NO_SLOT 0xffffffffu
 
 using namespace Inanity;
 
-namespace Spatial
-{
-	template<class T>
-	class IIndex2D;
-};
-
 namespace Firstblood
 {
 
-	class RvoAgent : public ISpatiallyIndexable, public Inanity::RefCounted, public RVO::Agent
+	class RvoFlowField : public RVO::FlowField, public Inanity::Object
+	{
+	public:
+		RvoFlowField(const vec2& origin, float cellSize, size_t width, size_t height);
+
+		void setGoal(const vec2& goal);
+		void setBlocked(const vec2& min, const vec2& max, bool blocked);
+
+	META_DECLARE_CLASS( RvoFlowField );
+	};
+
+
+	// agent handle given to scripts: slot index in the low bits, slot generation in the high ones
+	// the generation is bumped when the slot is freed, so stale handles are detected in O(1); 0 is never valid
+	// slots which ran out of generations are retired, running out of slots aborts
+	typedef uint32_t RvoAgentHandle;
+
+	class RvoAgent : public ISpatiallyIndexable, public RVO::Agent
 	{
 	public:
+		RvoAgent() : ISpatiallyIndexable(spatialEntityRvoAgent) {}
+
 		virtual bool raycast(const vec3& origin, const vec3& end, float& dist) { return true; };
 		virtual float getRadius() { return radius; };
 		virtual vec3 getPosition() { return vec3(position.x, position.y, 0); };
 		virtual uint32_t getMask() { return mask; };
 		virtual vec2 getVelocity() { return velocity_; };
-
-		void setMaxNeighbors(int value);
-		void setImmobilized(bool value);
-		void setTimeHorizon(float horizon);
-		void setMask(uint32_t mask);
-		float getMaxSpeed();
-		void setMaxSpeed(float value);
-		void setPrefVelocity(const vec2& velocity);
-
-		void FreeAsNotReferenced();
-
-	META_DECLARE_CLASS( RvoAgent );
 	};
 
 
-	class RvoSimulation : public RVO::Simulator, public RVO::NearestNeighborsFinder, public Inanity::Object
+	class RvoSimulation : public RVO::Simulator, public ISpatialProvider, public RVO::INeighborIndex, public Inanity::Object
 	{
 	public:
-		RvoSimulation(size_t maxAgents, Spatial::IIndex2D<ISpatiallyIndexable>* spatialIndex);
+		// agents memory grows by pages of initialCapacity agents
+		RvoSimulation(size_t initialCapacity);
 		virtual ~RvoSimulation();
 
-		ptr<RvoAgent> create(const vec2& position, int uid);
-		void destroy(ptr<RvoAgent> agent);
+		RvoAgentHandle create(const vec2& position, int uid);
+		// repeated destroy of the same agent within a frame is ignored
+		void destroy(RvoAgentHandle handle);
+		// false for stale handles and agents being destroyed
+		bool isAlive(RvoAgentHandle handle);
+		// nullptr for stale handles
+		RvoAgent* getAgent(RvoAgentHandle handle);
+		ptr<RvoFlowField> createFlowField(const vec2& origin, float cellSize, size_t width, size_t height);
+		void destroyFlowField(ptr<RvoFlowField> field);
 		void update(float dt);
 		void postUpdate();
 
@@ -59,16 +82,71 @@ namespace Firstblood
 		void setAgentDefaults(float neighborDist, size_t maxNeighbors, float timeHorizon, float radius, float maxSpeed);
 		size_t getNumAgents();
 		size_t getMaxAgents();
+		void setLodFocus(const vec2& focus);
+		void setLodLevel(size_t level, float minDistance, size_t updatePeriod, size_t maxNeighbors, bool steeringOnly);
+
+		// agent accessors for scripts, stale handles are ignored
+		vec2 getPosition(RvoAgentHandle handle);
+		float getRadius(RvoAgentHandle handle);
+		uint32_t getMask(RvoAgentHandle handle);
+		void setMask(RvoAgentHandle handle, uint32_t mask);
+		void setMaxNeighbors(RvoAgentHandle handle, int value);
+		void setImmobilized(RvoAgentHandle handle, bool value);
+		void setTimeHorizon(RvoAgentHandle handle, float horizon);
+		float getMaxSpeed(RvoAgentHandle handle);
+		void setMaxSpeed(RvoAgentHandle handle, float value);
+		void setPrefVelocity(RvoAgentHandle handle, const vec2& velocity);
+		void setFlowField(RvoAgentHandle handle, ptr<RvoFlowField> field);
+
+		// ISpatialProvider, agents added or removed in postUpdate
+		size_t getSpatialCount();
+		void collectSpatialData(ISpatiallyIndexable** entities);
+
+		// agents take neighbours from the global spatial index, which is built before the step is solved
+		void setSpatialIndex(Spatial::IIndex2D<ISpatiallyIndexable>* index);
+		// INeighborIndex, other entities of the index are skipped
+		size_t getNeighborAgents(const RVO::Agent* agent, float distance, uint32_t* result, size_t maxResultLength) const;
 
-		size_t collectSpatialData(ISpatiallyIndexable** list, size_t maxSize);
-
-		virtual size_t find(RVO::Agent* agent, RVO::NeighborEntity* result, size_t maxResultLength);
+	private:
+		struct AgentSlot
+		{
+			std::atomic<RvoAgent*> agent;
+			// generation, with RVO_HANDLE_TOMBSTONE set while the agent waits for removal
+			std::atomic<uint32_t> state;
+			// links of the free list and of the request lists, a slot is in each of them at most once
+			std::atomic<uint32_t> nextFree;
+			std::atomic<uint32_t> nextAdded;
+			std::atomic<uint32_t> nextRemoved;
+		};
+
+		AgentSlot* getSlot(uint32_t index) const;
+		// a slot freed in one of the previous frames or a fresh one
+		uint32_t allocSlot();
+		void freeSlot(uint32_t index);
+		// any thread pushes, postUpdate takes the whole list at once, so there is no ABA
+		void pushRequest(std::atomic<uint32_t>& head, std::atomic<uint32_t> AgentSlot::* link, uint32_t index);
+		// slot indices of the list in order of requests
+		void takeRequests(std::atomic<uint32_t>& head, std::atomic<uint32_t> AgentSlot::* link, std::vector<uint32_t>& slots);
 
 	private:
+		// agents may be created and destroyed from worker threads
+		ConcurrentPool<RvoAgent>* _agentsPool;
+		// create, destroy and handle lookups don't lock: chunks are added with a CAS and never move,
+		// requests and free slots are intrusive lists of slot indices
+		// accessors are for the scripts' thread only, as agents are destroyed in postUpdate
+		std::atomic<AgentSlot*> _slotChunks[RVO_SLOT_CHUNKS_COUNT];
+		std::atomic<uint32_t> _slotsCount;
+		// free slot index tagged with a counter against ABA, like ConcurrentPool's global stack
+		std::atomic<uint64_t> _freeSlotsHead;
+		// requests of the current frame, newest first, taken whole by postUpdate
+		std::atomic<uint32_t> _addedHead;
+		std::atomic<uint32_t> _removedHead;
+		// buffers of postUpdate, reused between frames
+		std::vector<uint32_t> _addedSlots;
+		std::vector<uint32_t> _removedSlots;
+		std::vector<RVO::Agent*> _removedAgents;
+		std::vector<ptr<RvoFlowField>> _flowFieldsOwned;
 		Spatial::IIndex2D<ISpatiallyIndexable>* _spatialIndex;
-		PoolAllocator* _allocator;
-		std::vector<RvoAgent*> toBeAddedQueue;
-		std::vector<RvoAgent*> toBeRemovedQueue;
 
 	META_DECLARE_CLASS( RvoSimulation );
 	};
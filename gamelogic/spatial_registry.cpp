@@ -0,0 +1,57 @@
+#include <algorithm>
+#include "gamelogic/spatial_registry.hpp"
+#include "jobs/job_system.hpp"
+
+namespace Firstblood
+{
+
+	SpatialRegistry::SpatialRegistry() : _entitiesCount(0) {}
+
+	void SpatialRegistry::addProvider(ISpatialProvider* provider)
+	{
+		_providers.push_back(provider);
+		_offsets.push_back(0);
+	}
+
+	void SpatialRegistry::removeProvider(ISpatialProvider* provider)
+	{
+		std::vector<ISpatialProvider*>::iterator i = std::find(_providers.begin(), _providers.end(), provider);
+		if (i == _providers.end())
+			return;
+		_providers.erase(i);
+		_offsets.pop_back();
+	}
+
+	void SpatialRegistry::collect(JobSystem* jobs)
+	{
+		_entitiesCount = 0;
+		for (size_t i = 0; i < _providers.size(); ++i)
+		{
+			_offsets[i] = _entitiesCount;
+			_entitiesCount += _providers[i]->getSpatialCount();
+		}
+		if (_entities.size() < _entitiesCount)
+			_entities.resize(_entitiesCount);
+		if (_entitiesCount == 0)
+			return;
+
+		// a provider per chunk, with few providers it's no more than a handful of jobs
+		jobs->parallelFor([](void* data, size_t begin, size_t end)
+		{
+			SpatialRegistry* registry = static_cast<SpatialRegistry*>(data);
+			for (size_t i = begin; i < end; ++i)
+				registry->_providers[i]->collectSpatialData(registry->_entities.data() + registry->_offsets[i]);
+		}, this, _providers.size(), 1);
+	}
+
+	ISpatiallyIndexable** SpatialRegistry::getEntities()
+	{
+		return _entitiesCount > 0 ? &_entities[0] : nullptr;
+	}
+
+	size_t SpatialRegistry::getEntitiesCount() const
+	{
+		return _entitiesCount;
+	}
+
+}
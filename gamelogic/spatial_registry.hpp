@@ -0,0 +1,39 @@
+#ifndef __FB_GAMELOGIC_SPATIAL_REGISTRY_HPP__
+#define __FB_GAMELOGIC_SPATIAL_REGISTRY_HPP__
+
+#include <vector>
+#include "gamelogic/common.hpp"
+
+class JobSystem;
+
+namespace Firstblood
+{
+
+	// gathers entities of all registered subsystems into one buffer for the spatial index build
+	// the buffer is kept between frames and only grows, so a steady world doesn't allocate
+	class SpatialRegistry
+	{
+	public:
+		SpatialRegistry();
+
+		void addProvider(ISpatialProvider* provider);
+		void removeProvider(ISpatialProvider* provider);
+
+		// providers report their counts, then fill their ranges of the buffer in parallel
+		// entities must not be added or removed meanwhile
+		void collect(JobSystem* jobs);
+
+		ISpatiallyIndexable** getEntities();
+		size_t getEntitiesCount() const;
+
+	private:
+		std::vector<ISpatialProvider*> _providers;
+		// where each provider's range begins
+		std::vector<size_t> _offsets;
+		std::vector<ISpatiallyIndexable*> _entities;
+		size_t _entitiesCount;
+	};
+
+}
+
+#endif
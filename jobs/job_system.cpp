@@ -0,0 +1,239 @@
+#include "jobs/job_system.hpp"
+#include "profiler/scope_profiler.h"
+#include <algorithm>
+#include <assert.h>
+#include <stdio.h>
+
+// chunks of a split parallel for are pushed by batches of this size
+#define JOB_SYSTEM_PUSH_BATCH 64
+
+JobSystem::JobSystem(size_t workersCount) : _jobsCreated(0), _queueHead(0), _queueSize(0), _stopping(false)
+{
+	_jobs = new Job[JOB_SYSTEM_MAX_JOBS];
+	for (size_t i = 0; i < JOB_SYSTEM_MAX_JOBS; ++i)
+	{
+		_jobs[i].unfinished.store(0);
+		_jobs[i].pendingDependencies.store(0);
+	}
+
+	if (workersCount == 0)
+	{
+		size_t hardwareThreads = (size_t)std::thread::hardware_concurrency();
+		workersCount = hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+	}
+	_workers.reserve(workersCount);
+	for (size_t i = 0; i < workersCount; ++i)
+		_workers.push_back(std::thread(&JobSystem::work, this, i));
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(_queueMutex);
+		_stopping = true;
+	}
+	_queueCondition.notify_all();
+	for (size_t i = 0; i < _workers.size(); ++i)
+		_workers[i].join();
+	delete [] _jobs;
+}
+
+size_t JobSystem::getWorkersCount() const
+{
+	return _workers.size();
+}
+
+Job* JobSystem::allocate()
+{
+	Job* job = &_jobs[_jobsCreated.fetch_add(1, std::memory_order_relaxed) & (JOB_SYSTEM_MAX_JOBS - 1)];
+	// the ring wrapped onto a job in flight
+	assert(job->unfinished.load(std::memory_order_relaxed) == 0);
+	job->function = nullptr;
+	job->data = nullptr;
+	job->begin = 0;
+	job->end = 1;
+	job->grain = 0;
+	job->parent = nullptr;
+	job->unfinished.store(1, std::memory_order_relaxed);
+	job->pendingDependencies.store(1, std::memory_order_relaxed);
+	job->continuationsCount = 0;
+	return job;
+}
+
+Job* JobSystem::create(JobFunction function, void* data)
+{
+	Job* job = allocate();
+	job->function = function;
+	job->data = data;
+	return job;
+}
+
+Job* JobSystem::createParallelFor(JobFunction function, void* data, size_t count, size_t grain)
+{
+	Job* job = allocate();
+	job->function = function;
+	job->data = data;
+	job->end = count;
+	job->grain = std::max((size_t)1, grain);
+	return job;
+}
+
+void JobSystem::addDependency(Job* job, Job* dependency)
+{
+	assert(dependency->continuationsCount < JOB_SYSTEM_MAX_CONTINUATIONS);
+	dependency->continuations[dependency->continuationsCount++] = job;
+	job->pendingDependencies.fetch_add(1, std::memory_order_relaxed);
+}
+
+void JobSystem::submit(Job* job)
+{
+	if (job->pendingDependencies.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		push(&job, 1);
+}
+
+bool JobSystem::isFinished(const Job* job) const
+{
+	return job->unfinished.load(std::memory_order_acquire) == 0;
+}
+
+void JobSystem::wait(const Job* job)
+{
+	while (!isFinished(job))
+	{
+		Job* other = tryPop();
+		if (other != nullptr)
+			execute(other);
+		else
+			std::this_thread::yield();
+	}
+}
+
+void JobSystem::parallelFor(JobFunction function, void* data, size_t count, size_t grain)
+{
+	if (count == 0)
+		return;
+	if (_workers.empty() || count <= grain)
+	{
+		function(data, 0, count);
+		return;
+	}
+	Job* job = createParallelFor(function, data, count, grain);
+	submit(job);
+	wait(job);
+}
+
+void JobSystem::push(Job* const* jobs, size_t count)
+{
+	{
+		std::lock_guard<std::mutex> lock(_queueMutex);
+		assert(_queueSize + count <= JOB_SYSTEM_MAX_JOBS);
+		for (size_t i = 0; i < count; ++i)
+			_queue[(_queueHead + _queueSize++) & (JOB_SYSTEM_MAX_JOBS - 1)] = jobs[i];
+	}
+	if (count == 1)
+		_queueCondition.notify_one();
+	else
+		_queueCondition.notify_all();
+}
+
+Job* JobSystem::tryPop()
+{
+	std::lock_guard<std::mutex> lock(_queueMutex);
+	if (_queueSize == 0)
+		return nullptr;
+	Job* job = _queue[_queueHead];
+	_queueHead = (_queueHead + 1) & (JOB_SYSTEM_MAX_JOBS - 1);
+	--_queueSize;
+	return job;
+}
+
+void JobSystem::execute(Job* job)
+{
+	if (job->grain > 0)
+	{
+		split(job);
+		return;
+	}
+	job->function(job->data, job->begin, job->end);
+	finish(job);
+}
+
+// chunks are children of the parallel for, which finishes after the last of them
+void JobSystem::split(Job* job)
+{
+	size_t count = job->end;
+	size_t maxChunks = (_workers.size() + 1) * JOB_SYSTEM_CHUNKS_PER_THREAD;
+	size_t chunkSize = std::max(job->grain, (count + maxChunks - 1) / maxChunks);
+	size_t chunksCount = (count + chunkSize - 1) / chunkSize;
+	job->unfinished.fetch_add((int32_t)chunksCount, std::memory_order_relaxed);
+
+	// the first chunk runs right here
+	Job* batch[JOB_SYSTEM_PUSH_BATCH];
+	size_t batchSize = 0;
+	for (size_t i = 1; i < chunksCount; ++i)
+	{
+		Job* chunk = create(job->function, job->data);
+		chunk->begin = i * chunkSize;
+		chunk->end = std::min(count, chunk->begin + chunkSize);
+		chunk->parent = job;
+		chunk->pendingDependencies.store(0, std::memory_order_relaxed);
+		batch[batchSize++] = chunk;
+		if (batchSize == JOB_SYSTEM_PUSH_BATCH)
+		{
+			push(batch, batchSize);
+			batchSize = 0;
+		}
+	}
+	if (batchSize > 0)
+		push(batch, batchSize);
+
+	job->function(job->data, 0, std::min(count, chunkSize));
+	// for the first chunk and for the job itself
+	job->unfinished.fetch_sub(1, std::memory_order_acq_rel);
+	finish(job);
+}
+
+void JobSystem::finish(Job* job)
+{
+	// the slot may be taken by a new job as soon as this one is finished, so the links are read beforehand
+	Job* parent = job->parent;
+	Job* continuations[JOB_SYSTEM_MAX_CONTINUATIONS];
+	size_t continuationsCount = job->continuationsCount;
+	for (size_t i = 0; i < continuationsCount; ++i)
+		continuations[i] = job->continuations[i];
+
+	if (job->unfinished.fetch_sub(1, std::memory_order_acq_rel) != 1)
+		return;
+
+	size_t readyCount = 0;
+	for (size_t i = 0; i < continuationsCount; ++i)
+		if (continuations[i]->pendingDependencies.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			continuations[readyCount++] = continuations[i];
+	if (readyCount > 0)
+		push(continuations, readyCount);
+
+	if (parent != nullptr)
+		finish(parent);
+}
+
+void JobSystem::work(size_t index)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "worker %u", (unsigned)index);
+	ScopeProfiler::setThreadName(name);
+
+	for (;;)
+	{
+		Job* job;
+		{
+			std::unique_lock<std::mutex> lock(_queueMutex);
+			_queueCondition.wait(lock, [this]() { return _stopping || _queueSize > 0; });
+			if (_stopping)
+				return;
+			job = _queue[_queueHead];
+			_queueHead = (_queueHead + 1) & (JOB_SYSTEM_MAX_JOBS - 1);
+			--_queueSize;
+		}
+		execute(job);
+	}
+}
@@ -0,0 +1,94 @@
+#ifndef __FBE_JOB_SYSTEM_HPP__
+#define __FBE_JOB_SYSTEM_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+// jobs live in a ring and are reused after this many more are created, which bounds jobs in flight
+#define JOB_SYSTEM_MAX_JOBS 4096
+#define JOB_SYSTEM_MAX_CONTINUATIONS 8
+// parallel for makes at most this many chunks per thread, however small the grain is
+#define JOB_SYSTEM_CHUNKS_PER_THREAD 4
+
+// called with [begin, end) of a parallel for chunk, or with [0, 1) for a plain job
+// captureless lambdas convert to it
+typedef void (*JobFunction)(void* data, size_t begin, size_t end);
+
+struct Job
+{
+	JobFunction function;
+	void* data;
+	size_t begin;
+	size_t end;
+	// items per chunk for a parallel for which is not split yet, 0 otherwise
+	size_t grain;
+	// parallel for which this chunk belongs to
+	Job* parent;
+	// the job itself and its unfinished chunks
+	std::atomic<int32_t> unfinished;
+	// unfinished dependencies, plus one until the job is submitted
+	std::atomic<int32_t> pendingDependencies;
+	// jobs depending on this one
+	Job* continuations[JOB_SYSTEM_MAX_CONTINUATIONS];
+	size_t continuationsCount;
+};
+
+// worker pool running a graph of jobs: create jobs, wire dependencies, submit, wait for the last one
+// the graph is wired before its jobs are submitted, dependencies can't be added to running jobs
+// a waiting thread runs queued jobs itself, so waits may be nested inside jobs
+class JobSystem
+{
+public:
+	// 0 workers is one less than hardware threads, as the main thread works while it waits
+	JobSystem(size_t workersCount = 0);
+	~JobSystem();
+
+	size_t getWorkersCount() const;
+
+	Job* create(JobFunction function, void* data);
+	// function is called for chunks of [0, count) of at least grain items, possibly on different threads
+	// the job is split into chunks once its dependencies are finished
+	Job* createParallelFor(JobFunction function, void* data, size_t count, size_t grain);
+	// job doesn't start until dependency is finished
+	void addDependency(Job* job, Job* dependency);
+	void submit(Job* job);
+	bool isFinished(const Job* job) const;
+	void wait(const Job* job);
+
+	// create, submit and wait, runs on the calling thread alone when there are no workers or a single chunk
+	void parallelFor(JobFunction function, void* data, size_t count, size_t grain);
+
+private:
+	Job* allocate();
+	void push(Job* const* jobs, size_t count);
+	Job* tryPop();
+	void execute(Job* job);
+	void split(Job* job);
+	void finish(Job* job);
+	void work(size_t index);
+
+private:
+	JobSystem(const JobSystem&);
+	JobSystem& operator=(const JobSystem&);
+
+private:
+	Job* _jobs;
+	std::atomic<uint32_t> _jobsCreated;
+
+	// fifo ring of ready jobs, never longer than the jobs ring
+	std::mutex _queueMutex;
+	std::condition_variable _queueCondition;
+	Job* _queue[JOB_SYSTEM_MAX_JOBS];
+	size_t _queueHead;
+	size_t _queueSize;
+	bool _stopping;
+
+	std::vector<std::thread> _workers;
+};
+
+#endif
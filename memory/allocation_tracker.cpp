@@ -0,0 +1,69 @@
+#include "memory/allocation_tracker.hpp"
+#include "profiler/scope_profiler.h"
+#include <cstdlib>
+#include <new>
+
+const char* AllocationTracker::getZoneName(const ProfilerZone* zone)
+{
+	return zone != nullptr ? zone->name : "(outside of zones)";
+}
+
+#if defined(FIRSTBLOOD_TRACK_ALLOCATIONS)
+
+// replacements of the global operators, the rest of the standard forms forward to these
+void* operator new(size_t size)
+{
+	TRACK_ALLOCATION(size);
+	void* memory = malloc(size > 0 ? size : 1);
+	if (memory == nullptr)
+		throw std::bad_alloc();
+	return memory;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	TRACK_ALLOCATION(size);
+	return malloc(size > 0 ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return operator new(size, std::nothrow);
+}
+
+void operator delete(void* memory) noexcept
+{
+	free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	free(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept
+{
+	free(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept
+{
+	free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept
+{
+	free(memory);
+}
+
+#endif
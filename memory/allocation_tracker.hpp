@@ -0,0 +1,266 @@
+#ifndef __FBE_ALLOCATION_TRACKER_HPP__
+#define __FBE_ALLOCATION_TRACKER_HPP__
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <atomic>
+
+#if defined(FIRSTBLOOD_TRACK_ALLOCATIONS)
+#if defined(_MSC_VER)
+#include <windows.h>
+#define ALLOCATION_TRACKER_CAPTURE_STACK
+#elif defined(__GLIBC__) || defined(__APPLE__)
+#include <execinfo.h>
+#define ALLOCATION_TRACKER_CAPTURE_STACK
+#define ALLOCATION_TRACKER_EXECINFO
+#endif
+#endif
+
+#define ALLOCATION_TRACKER_MAX_ZONES 128
+#define ALLOCATION_TRACKER_MAX_CALL_SITES 64
+#define ALLOCATION_TRACKER_CALL_SITE_DEPTH 12
+#define ALLOCATION_TRACKER_DEFAULT_SAMPLE_PERIOD 16
+
+// build with FIRSTBLOOD_TRACK_ALLOCATIONS to count heap allocations: operator new is replaced
+// (memory/allocation_tracker.cpp) and our allocators report the memory they take from malloc themselves
+// malloc calls of third party code (v8, drivers) are not seen
+#if defined(FIRSTBLOOD_TRACK_ALLOCATIONS)
+#define TRACK_ALLOCATION( SIZE ) AllocationTracker::getInstance().onAllocation(SIZE)
+#else
+#define TRACK_ALLOCATION( SIZE )
+#endif
+
+struct ProfilerZone;
+
+struct AllocationCounters
+{
+	uint64_t count;
+	uint64_t bytes;
+};
+
+// allocations made inside a profiler zone (the innermost one), zone is null outside of all zones
+struct AllocationZoneCounters
+{
+	const ProfilerZone* zone;
+	AllocationCounters counters;
+};
+
+struct AllocationCallSite
+{
+	void* frames[ALLOCATION_TRACKER_CALL_SITE_DEPTH];
+	size_t depth;
+	AllocationCounters counters;
+};
+
+// counts allocations per frame, per profiler zone and per sampled call site
+// the hook is guarded by a spinlock and doesn't allocate itself, tables have fixed sizes and overflowing entries are dropped
+class AllocationTracker
+{
+public:
+	AllocationTracker() : _samplePeriod(ALLOCATION_TRACKER_DEFAULT_SAMPLE_PERIOD), _samplesCounter(0), _totalCount(0)
+	{
+		_lock.clear();
+		_current.reset();
+		_last.reset();
+	}
+
+	static AllocationTracker& getInstance()
+	{
+		static AllocationTracker instance;
+		return instance;
+	}
+
+	// innermost zone of the calling thread, set by AllocationScope
+	static const ProfilerZone*& getCurrentZone()
+	{
+		static thread_local const ProfilerZone* zone = nullptr;
+		return zone;
+	}
+
+	// every period-th allocation has its call stack captured, 1 captures all of them
+	void setSamplePeriod(uint32_t period)
+	{
+		_samplePeriod.store(period > 0 ? period : 1);
+	}
+
+	void onAllocation(size_t size)
+	{
+		// capturing a stack may allocate itself
+		static thread_local bool inside = false;
+		if (inside)
+			return;
+		inside = true;
+
+		void* frames[ALLOCATION_TRACKER_CALL_SITE_DEPTH];
+		size_t depth = 0;
+		if (_samplesCounter.fetch_add(1, std::memory_order_relaxed) % _samplePeriod.load(std::memory_order_relaxed) == 0)
+			depth = captureStack(frames);
+		const ProfilerZone* zone = getCurrentZone();
+
+		while (_lock.test_and_set(std::memory_order_acquire));
+		_current.add(zone, size, frames, depth);
+		++_totalCount;
+		_lock.clear(std::memory_order_release);
+
+		inside = false;
+	}
+
+	// what was counted since the previous call becomes the last frame
+	void beginFrame()
+	{
+		while (_lock.test_and_set(std::memory_order_acquire));
+		_last = _current;
+		_current.reset();
+		_lock.clear(std::memory_order_release);
+	}
+
+	const AllocationCounters& getFrameCounters() const
+	{
+		return _last.counters;
+	}
+
+	size_t getFrameZonesCount() const
+	{
+		return _last.zonesCount;
+	}
+
+	const AllocationZoneCounters& getFrameZone(size_t i) const
+	{
+		return _last.zones[i];
+	}
+
+	uint64_t getTotalCount() const
+	{
+		return _totalCount;
+	}
+
+	// last frame by zones and sampled call sites, symbols are resolved where the platform can do it without allocating
+	void report(FILE* file) const
+	{
+		fprintf(file, "allocations in frame: %llu, %llu bytes\n", (unsigned long long)_last.counters.count, (unsigned long long)_last.counters.bytes);
+		for (size_t i = 0; i < _last.zonesCount; ++i)
+			fprintf(file, "  %-32s %8llu %12llu bytes\n", getZoneName(_last.zones[i].zone),
+				(unsigned long long)_last.zones[i].counters.count, (unsigned long long)_last.zones[i].counters.bytes);
+		for (size_t i = 0; i < _last.callSitesCount; ++i)
+		{
+			const AllocationCallSite& site = _last.callSites[i];
+			fprintf(file, "call site sampled %llu times, %llu bytes:\n", (unsigned long long)site.counters.count, (unsigned long long)site.counters.bytes);
+			fflush(file);
+#if defined(ALLOCATION_TRACKER_EXECINFO)
+			backtrace_symbols_fd(const_cast<void* const*>(site.frames), (int)site.depth, fileno(file));
+#else
+			for (size_t j = 0; j < site.depth; ++j)
+				fprintf(file, "  %p\n", site.frames[j]);
+#endif
+		}
+		fflush(file);
+	}
+
+private:
+	struct Frame
+	{
+		AllocationCounters counters;
+		AllocationZoneCounters zones[ALLOCATION_TRACKER_MAX_ZONES];
+		size_t zonesCount;
+		AllocationCallSite callSites[ALLOCATION_TRACKER_MAX_CALL_SITES];
+		size_t callSitesCount;
+
+		void reset()
+		{
+			counters.count = 0;
+			counters.bytes = 0;
+			zonesCount = 0;
+			callSitesCount = 0;
+		}
+
+		void add(const ProfilerZone* zone, size_t size, void* const* frames, size_t depth)
+		{
+			++counters.count;
+			counters.bytes += size;
+
+			size_t i = 0;
+			while (i < zonesCount && zones[i].zone != zone)
+				++i;
+			if (i == zonesCount && zonesCount < ALLOCATION_TRACKER_MAX_ZONES)
+			{
+				zones[zonesCount].zone = zone;
+				zones[zonesCount].counters.count = 0;
+				zones[zonesCount].counters.bytes = 0;
+				++zonesCount;
+			}
+			if (i < zonesCount)
+			{
+				++zones[i].counters.count;
+				zones[i].counters.bytes += size;
+			}
+
+			if (depth == 0)
+				return;
+			i = 0;
+			while (i < callSitesCount && !(callSites[i].depth == depth && memcmp(callSites[i].frames, frames, depth * sizeof(void*)) == 0))
+				++i;
+			if (i == callSitesCount)
+			{
+				if (callSitesCount == ALLOCATION_TRACKER_MAX_CALL_SITES)
+					return;
+				memcpy(callSites[i].frames, frames, depth * sizeof(void*));
+				callSites[i].depth = depth;
+				callSites[i].counters.count = 0;
+				callSites[i].counters.bytes = 0;
+				++callSitesCount;
+			}
+			++callSites[i].counters.count;
+			callSites[i].counters.bytes += size;
+		}
+	};
+
+	static size_t captureStack(void** frames)
+	{
+#if defined(ALLOCATION_TRACKER_CAPTURE_STACK) && defined(_MSC_VER)
+		return CaptureStackBackTrace(0, ALLOCATION_TRACKER_CALL_SITE_DEPTH, frames, nullptr);
+#elif defined(ALLOCATION_TRACKER_CAPTURE_STACK)
+		int depth = backtrace(frames, ALLOCATION_TRACKER_CALL_SITE_DEPTH);
+		return depth > 0 ? (size_t)depth : 0;
+#else
+		(void)frames;
+		return 0;
+#endif
+	}
+
+	// in allocation_tracker.cpp, along with the hooks
+	static const char* getZoneName(const ProfilerZone* zone);
+
+private:
+	AllocationTracker(const AllocationTracker&);
+	AllocationTracker& operator=(const AllocationTracker&);
+
+private:
+	std::atomic_flag _lock;
+	std::atomic<uint32_t> _samplePeriod;
+	std::atomic<uint64_t> _samplesCounter;
+	uint64_t _totalCount;
+	Frame _current;
+	Frame _last;
+};
+
+
+class AllocationScope
+{
+public:
+	AllocationScope(const ProfilerZone* zone) : _previous(AllocationTracker::getCurrentZone())
+	{
+		AllocationTracker::getCurrentZone() = zone;
+	}
+
+	~AllocationScope()
+	{
+		AllocationTracker::getCurrentZone() = _previous;
+	}
+
+private:
+	const ProfilerZone* _previous;
+};
+
+#endif
@@ -2,70 +2,132 @@
 #define __FBE_ARENA_ALLOCATOR_HPP__
 
 #include <cstdlib>
+#include <new>
+#include <cstdint>
 #include <assert.h>
 #include <vector>
+#include <algorithm>
+#include "memory/allocation_tracker.hpp"
 
+#define ARENA_DEFAULT_ALIGNMENT sizeof(void*)
+
+// memory is handed out from a chain of chunks, a new chunk twice as big as the last one is chained when it runs out
+// purge keeps only the largest chunk, so after a few frames a single chunk fits the peak usage
 // dtors of allocated created via arena won't be called
 class ArenaAllocator
 {
 public:
-	ArenaAllocator(size_t totalSize) : _allocatedSize(0), _totalSize(totalSize)
+	ArenaAllocator(size_t initialSize) : _usedBeforeCurrentChunk(0), _chunkOffset(0), _highWaterMark(0)
 	{
-		_memory = static_cast<unsigned char*>(malloc(totalSize));
+		addChunk(std::max(initialSize, (size_t)1));
 	}
 
 	~ArenaAllocator()
 	{
-		free(static_cast<void*>(_memory));
-		clearOverflowAllocations();
+		for (size_t i = 0; i < _chunks.size(); ++i)
+			free(static_cast<void*>(_chunks[i].memory));
+		_chunks.clear();
 	}
 
-	inline void* allocMemory(size_t size)
+	// alignment must be a power of two
+	inline void* allocMemory(size_t size, size_t alignment = ARENA_DEFAULT_ALIGNMENT)
 	{
-		if (_allocatedSize + size <= _totalSize)
-		{
-			unsigned char* address = _memory + _allocatedSize;
-			_allocatedSize += size;
-			return static_cast<void*>(address);
-		}
-		else
+		assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+		Chunk* chunk = &_chunks.back();
+		size_t offset = alignOffset(*chunk, _chunkOffset, alignment);
+		if (offset + size > chunk->size)
 		{
-			// we don't want to crash our customer in case of arena overflow
-			// but still, it should be treated as a bug
-			assert(false);
-			void* overflowAllocation = malloc(size);
-			_overflowAllocations.push_back(overflowAllocation);
-			return overflowAllocation;
+			// the current chunk is always the last one, chain a new one big enough for the request
+			_usedBeforeCurrentChunk += _chunkOffset;
+			addChunk(std::max(chunk->size * 2, size + alignment));
+			chunk = &_chunks.back();
+			offset = alignOffset(*chunk, 0, alignment);
 		}
+
+		unsigned char* address = chunk->memory + offset;
+		_chunkOffset = offset + size;
+		_highWaterMark = std::max(_highWaterMark, getUsedSize());
+		return static_cast<void*>(address);
 	}
 
 	template<class T>
 	inline T* alloc()
 	{
-		void* memory = allocMemory(sizeof(T));
+		void* memory = allocMemory(sizeof(T), alignof(T));
 		return new (memory) T;
 	}
 
 	inline void purge()
 	{
-		_allocatedSize = 0;
-		clearOverflowAllocations();
+		if (_chunks.size() > 1)
+		{
+			// keep the largest chunk, which is the last one chained
+			std::vector<Chunk>::iterator largest = std::max_element(_chunks.begin(), _chunks.end());
+			std::swap(*largest, _chunks[0]);
+			for (size_t i = 1; i < _chunks.size(); ++i)
+				free(static_cast<void*>(_chunks[i].memory));
+			_chunks.resize(1);
+		}
+		_chunkOffset = 0;
+		_usedBeforeCurrentChunk = 0;
+	}
+
+	// bytes in use since the last purge, including alignment padding
+	inline size_t getUsedSize() const
+	{
+		return _usedBeforeCurrentChunk + _chunkOffset;
+	}
+
+	// peak of used size over the arena lifetime
+	inline size_t getHighWaterMark() const
+	{
+		return _highWaterMark;
+	}
+
+	inline size_t getCapacity() const
+	{
+		size_t capacity = 0;
+		for (size_t i = 0; i < _chunks.size(); ++i)
+			capacity += _chunks[i].size;
+		return capacity;
 	}
 
 private:
-	inline void clearOverflowAllocations()
+	struct Chunk
+	{
+		unsigned char* memory;
+		size_t size;
+
+		bool operator<(const Chunk& other) const
+		{
+			return size < other.size;
+		}
+	};
+
+	inline static size_t alignOffset(const Chunk& chunk, size_t offset, size_t alignment)
+	{
+		uintptr_t address = reinterpret_cast<uintptr_t>(chunk.memory) + offset;
+		return offset + ((alignment - (address & (alignment - 1))) & (alignment - 1));
+	}
+
+	void addChunk(size_t size)
 	{
-		for (size_t i = 0; i < _overflowAllocations.size(); ++i)
-			free(_overflowAllocations[i]);
-		_overflowAllocations.clear();
+		Chunk chunk;
+		TRACK_ALLOCATION(size);
+		chunk.memory = static_cast<unsigned char*>(malloc(size));
+		if (chunk.memory == nullptr)
+			throw std::bad_alloc();
+		chunk.size = size;
+		_chunks.push_back(chunk);
 	}
 
 private:
-	size_t _totalSize;
-	size_t _allocatedSize;
-	unsigned char* _memory;
-	std::vector<void*> _overflowAllocations;
+	std::vector<Chunk> _chunks;
+	size_t _usedBeforeCurrentChunk;
+	// position in the last chunk, the only one allocated from
+	size_t _chunkOffset;
+	size_t _highWaterMark;
 };
 
 
-#endif
\ No newline at end of file
+#endif
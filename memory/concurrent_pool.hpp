@@ -0,0 +1,347 @@
+#ifndef __FBE_CONCURRENT_POOL_HPP__
+#define __FBE_CONCURRENT_POOL_HPP__
+
+#include <cstdlib>
+#include <cstdint>
+#include <new>
+#include <atomic>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include <assert.h>
+#include "memory/allocation_tracker.hpp"
+
+#define CONCURRENT_POOL_MAX_PAGES 4096
+#define CONCURRENT_POOL_MAX_THREADS 64
+#define CONCURRENT_POOL_MAGAZINE_SIZE 64
+#define CONCURRENT_POOL_NO_CHUNK 0xffffffffu
+#define CONCURRENT_POOL_CACHE_LINE 64
+
+// keeps track of thread slots, which index magazines of all pools
+// taking and giving back a slot is locked, it happens once per thread
+class ConcurrentPoolBase
+{
+protected:
+	virtual ~ConcurrentPoolBase() {}
+
+	static size_t getThreadSlot()
+	{
+		static thread_local ThreadSlot slot;
+		return slot.index;
+	}
+
+	// pools must be registered for their whole life, so that exiting threads find their magazines
+	void registerPool()
+	{
+		Registry& registry = getRegistry();
+		std::lock_guard<std::mutex> lock(registry.mutex);
+		registry.pools.push_back(this);
+	}
+
+	void unregisterPool()
+	{
+		Registry& registry = getRegistry();
+		std::lock_guard<std::mutex> lock(registry.mutex);
+		for (size_t i = 0; i < registry.pools.size(); ++i)
+			if (registry.pools[i] == this)
+			{
+				registry.pools[i] = registry.pools.back();
+				registry.pools.pop_back();
+				break;
+			}
+	}
+
+	// gives chunks cached for the slot back to the global stack
+	virtual void flushMagazine(size_t slot) = 0;
+
+private:
+	struct Registry
+	{
+		std::mutex mutex;
+		std::vector<ConcurrentPoolBase*> pools;
+		// slots of exited threads, reused before new ones are counted
+		std::vector<size_t> freeSlots;
+		size_t slotsCount;
+
+		Registry() : slotsCount(0) {}
+	};
+
+	struct ThreadSlot
+	{
+		size_t index;
+
+		ThreadSlot()
+		{
+			Registry& registry = getRegistry();
+			std::lock_guard<std::mutex> lock(registry.mutex);
+			if (registry.freeSlots.empty())
+			{
+				index = registry.slotsCount++;
+			}
+			else
+			{
+				index = registry.freeSlots.back();
+				registry.freeSlots.pop_back();
+			}
+		}
+
+		~ThreadSlot()
+		{
+			// threads beyond the limit have no magazines and their slots are not worth reusing
+			if (index >= CONCURRENT_POOL_MAX_THREADS)
+				return;
+			Registry& registry = getRegistry();
+			std::lock_guard<std::mutex> lock(registry.mutex);
+			for (size_t i = 0; i < registry.pools.size(); ++i)
+				registry.pools[i]->flushMagazine(index);
+			registry.freeSlots.push_back(index);
+		}
+	};
+
+	// constructed before any thread slot, so it outlives them all
+	static Registry& getRegistry()
+	{
+		static Registry registry;
+		return registry;
+	}
+};
+
+
+// pool of objects which can be created and destroyed from any thread without a mutex
+// every thread has its own magazine of free chunks, only when it runs empty or overflows half of it is exchanged
+// with the global lock-free stack (Treiber stack, head is chunk index tagged with a counter against ABA)
+// pages are never moved or freed before the pool dies, adding a page is the only locked path
+// every chunk starts with its own index, so freeing doesn't have to look for the page
+// threads beyond CONCURRENT_POOL_MAX_THREADS alive at once go to the global stack directly
+// a thread exiting flushes its magazines in all pools and gives its slot to the next thread started
+template<class T>
+class ConcurrentPool : public ConcurrentPoolBase
+{
+public:
+	ConcurrentPool(size_t chunksPerPage) : _chunksPerPage(chunksPerPage > 0 ? chunksPerPage : 1), _pagesCount(0)
+	{
+		assert(chunksPerPage > 0);
+		size_t alignment = alignof(T) > alignof(std::atomic<uint32_t>) ? alignof(T) : alignof(std::atomic<uint32_t>);
+		_headerSize = (sizeof(uint32_t) + alignment - 1) / alignment * alignment;
+		size_t objectSize = sizeof(T) > sizeof(std::atomic<uint32_t>) ? sizeof(T) : sizeof(std::atomic<uint32_t>);
+		_chunkSize = (_headerSize + objectSize + alignment - 1) / alignment * alignment;
+		_head.store(packHead(CONCURRENT_POOL_NO_CHUNK, 0));
+		for (size_t i = 0; i < CONCURRENT_POOL_MAX_PAGES; ++i)
+			_pages[i].store(nullptr, std::memory_order_relaxed);
+		registerPool();
+	}
+
+	// objects still alive are not destroyed, only their memory is released
+	~ConcurrentPool()
+	{
+		unregisterPool();
+		size_t pagesCount = _pagesCount.load();
+		for (size_t i = 0; i < pagesCount; ++i)
+			free(_pages[i].load());
+	}
+
+	template<class... Args>
+	inline T* create(Args&&... args)
+	{
+		return new (allocMemory()) T(std::forward<Args>(args)...);
+	}
+
+	inline void destroy(T* object)
+	{
+		object->~T();
+		dealloc(object);
+	}
+
+	inline size_t getCapacity() const
+	{
+		return _pagesCount.load() * _chunksPerPage;
+	}
+
+	// linear in pages count, for asserts
+	bool owns(const T* object) const
+	{
+		const unsigned char* address = reinterpret_cast<const unsigned char*>(object);
+		size_t pagesCount = _pagesCount.load();
+		for (size_t i = 0; i < pagesCount; ++i)
+		{
+			const unsigned char* page = _pages[i].load();
+			if (address >= page && address < page + _chunksPerPage * _chunkSize)
+				return (size_t)(address - page) % _chunkSize == _headerSize;
+		}
+		return false;
+	}
+
+private:
+	// padded rather than aligned, over-aligned new is not there before C++17
+	struct Magazine
+	{
+		uint32_t chunks[CONCURRENT_POOL_MAGAZINE_SIZE];
+		size_t count;
+		char padding[CONCURRENT_POOL_CACHE_LINE - sizeof(size_t)];
+
+		Magazine() : count(0) {}
+	};
+
+	inline static uint64_t packHead(uint32_t index, uint32_t tag)
+	{
+		return ((uint64_t)tag << 32) | index;
+	}
+
+	// object memory of the chunk, right after the header
+	inline unsigned char* getChunk(uint32_t index) const
+	{
+		return _pages[index / _chunksPerPage].load(std::memory_order_acquire) + (index % _chunksPerPage) * _chunkSize + _headerSize;
+	}
+
+	// free chunks keep the link in object memory
+	inline std::atomic<uint32_t>& getNextLink(uint32_t index) const
+	{
+		return *reinterpret_cast<std::atomic<uint32_t>*>(getChunk(index));
+	}
+
+	inline uint32_t getChunkIndex(void* memory) const
+	{
+		return *reinterpret_cast<uint32_t*>(static_cast<unsigned char*>(memory) - _headerSize);
+	}
+
+	inline void* allocMemory()
+	{
+		size_t slot = getThreadSlot();
+		if (slot >= CONCURRENT_POOL_MAX_THREADS)
+			return getChunk(popGlobal());
+
+		Magazine& magazine = _magazines[slot];
+		if (magazine.count == 0)
+		{
+			// refill half of the magazine, so that alloc/free ping-pong doesn't hit the global stack every time
+			magazine.chunks[magazine.count++] = popGlobal();
+			while (magazine.count < CONCURRENT_POOL_MAGAZINE_SIZE / 2)
+			{
+				uint32_t index = tryPopGlobal();
+				if (index == CONCURRENT_POOL_NO_CHUNK)
+					break;
+				magazine.chunks[magazine.count++] = index;
+			}
+		}
+		return getChunk(magazine.chunks[--magazine.count]);
+	}
+
+	inline void dealloc(void* memory)
+	{
+		uint32_t index = getChunkIndex(memory);
+		size_t slot = getThreadSlot();
+		if (slot >= CONCURRENT_POOL_MAX_THREADS)
+		{
+			pushGlobal(index, index);
+			return;
+		}
+
+		Magazine& magazine = _magazines[slot];
+		if (magazine.count == CONCURRENT_POOL_MAGAZINE_SIZE)
+		{
+			// link the upper half into a chain and give it back with a single CAS
+			size_t first = CONCURRENT_POOL_MAGAZINE_SIZE / 2;
+			for (size_t i = first; i + 1 < CONCURRENT_POOL_MAGAZINE_SIZE; ++i)
+				getNextLink(magazine.chunks[i]).store(magazine.chunks[i + 1], std::memory_order_relaxed);
+			pushGlobal(magazine.chunks[first], magazine.chunks[CONCURRENT_POOL_MAGAZINE_SIZE - 1]);
+			magazine.count = first;
+		}
+		magazine.chunks[magazine.count++] = index;
+	}
+
+	// called on the exiting thread with the registry locked, so the pool is alive and the magazine is its own
+	void flushMagazine(size_t slot)
+	{
+		Magazine& magazine = _magazines[slot];
+		if (magazine.count == 0)
+			return;
+		for (size_t i = 0; i + 1 < magazine.count; ++i)
+			getNextLink(magazine.chunks[i]).store(magazine.chunks[i + 1], std::memory_order_relaxed);
+		pushGlobal(magazine.chunks[0], magazine.chunks[magazine.count - 1]);
+		magazine.count = 0;
+	}
+
+	// pushes chain first..last, linked by next links
+	void pushGlobal(uint32_t first, uint32_t last)
+	{
+		uint64_t head = _head.load(std::memory_order_relaxed);
+		do
+		{
+			getNextLink(last).store((uint32_t)head, std::memory_order_relaxed);
+		}
+		while (!_head.compare_exchange_weak(head, packHead(first, (uint32_t)(head >> 32) + 1), std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	uint32_t tryPopGlobal()
+	{
+		uint64_t head = _head.load(std::memory_order_acquire);
+		while (true)
+		{
+			uint32_t index = (uint32_t)head;
+			if (index == CONCURRENT_POOL_NO_CHUNK)
+				return CONCURRENT_POOL_NO_CHUNK;
+			// the chunk may be popped and reused meanwhile, then the tag check fails and the read value is dropped
+			uint32_t next = getNextLink(index).load(std::memory_order_relaxed);
+			if (_head.compare_exchange_weak(head, packHead(next, (uint32_t)(head >> 32) + 1), std::memory_order_acquire, std::memory_order_acquire))
+				return index;
+		}
+	}
+
+	uint32_t popGlobal()
+	{
+		while (true)
+		{
+			uint32_t index = tryPopGlobal();
+			if (index != CONCURRENT_POOL_NO_CHUNK)
+				return index;
+			addPage();
+		}
+	}
+
+	// several threads may find the stack empty at once, only one of them adds a page
+	void addPage()
+	{
+		std::lock_guard<std::mutex> lock(_growMutex);
+		if ((uint32_t)_head.load(std::memory_order_acquire) != CONCURRENT_POOL_NO_CHUNK)
+			return;
+
+		size_t pageIndex = _pagesCount.load(std::memory_order_relaxed);
+		assert(pageIndex < CONCURRENT_POOL_MAX_PAGES);
+		if (pageIndex >= CONCURRENT_POOL_MAX_PAGES)
+			abort();
+		TRACK_ALLOCATION(_chunksPerPage * _chunkSize);
+		unsigned char* page = static_cast<unsigned char*>(malloc(_chunksPerPage * _chunkSize));
+		// fails like running out of page slots above
+		if (page == nullptr)
+			abort();
+		for (size_t i = 0; i < _chunksPerPage; ++i)
+		{
+			uint32_t index = (uint32_t)(pageIndex * _chunksPerPage + i);
+			*reinterpret_cast<uint32_t*>(page + i * _chunkSize) = index;
+			new (page + i * _chunkSize + _headerSize) std::atomic<uint32_t>(index + 1);
+		}
+		_pages[pageIndex].store(page, std::memory_order_release);
+		_pagesCount.store(pageIndex + 1, std::memory_order_release);
+
+		uint32_t first = (uint32_t)(pageIndex * _chunksPerPage);
+		pushGlobal(first, first + (uint32_t)_chunksPerPage - 1);
+	}
+
+private:
+	ConcurrentPool(const ConcurrentPool&);
+	ConcurrentPool& operator=(const ConcurrentPool&);
+
+private:
+	size_t _headerSize;
+	size_t _chunkSize;
+	size_t _chunksPerPage;
+	char _headPadding[CONCURRENT_POOL_CACHE_LINE];
+	std::atomic<uint64_t> _head;
+	char _tailPadding[CONCURRENT_POOL_CACHE_LINE];
+	std::atomic<unsigned char*> _pages[CONCURRENT_POOL_MAX_PAGES];
+	std::atomic<size_t> _pagesCount;
+	std::mutex _growMutex;
+	Magazine _magazines[CONCURRENT_POOL_MAX_THREADS];
+};
+
+#endif
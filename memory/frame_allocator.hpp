@@ -0,0 +1,106 @@
+#ifndef __FBE_FRAME_ALLOCATOR_HPP__
+#define __FBE_FRAME_ALLOCATOR_HPP__
+
+#include <cstddef>
+#include <vector>
+#include "memory/arena_allocator.hpp"
+
+#define FRAME_ALLOCATOR_INITIAL_SIZE (size_t)(1024 * 1024)
+
+// engine-wide allocator for data living no longer than a frame
+// two arenas are used in turns: beginFrame purges the older one, so data of the previous frame stays valid
+// for one more frame (e.g. for renderer consuming it while the next frame is simulated)
+// not thread safe, dtors of allocated objects won't be called
+// meant for data recorded and consumed on the main thread within the frame pair, like painter's debug vertices;
+// containers filled from other threads or kept across frames (rvo request queues, spatial registry's entities)
+// use their own storage reused between frames instead, which is allocation-free in a steady frame as well
+class FrameAllocator
+{
+public:
+	FrameAllocator() : _current(0)
+	{
+		_arenas[0] = new ArenaAllocator(FRAME_ALLOCATOR_INITIAL_SIZE);
+		_arenas[1] = new ArenaAllocator(FRAME_ALLOCATOR_INITIAL_SIZE);
+	}
+
+	~FrameAllocator()
+	{
+		delete _arenas[0];
+		delete _arenas[1];
+	}
+
+	static FrameAllocator& getInstance()
+	{
+		static FrameAllocator instance;
+		return instance;
+	}
+
+	// everything allocated two frames ago is released
+	inline void beginFrame()
+	{
+		_current ^= 1;
+		_arenas[_current]->purge();
+	}
+
+	inline void* allocMemory(size_t size, size_t alignment = ARENA_DEFAULT_ALIGNMENT)
+	{
+		return _arenas[_current]->allocMemory(size, alignment);
+	}
+
+	template<class T>
+	inline T* alloc()
+	{
+		return _arenas[_current]->alloc<T>();
+	}
+
+	inline size_t getUsedSize() const
+	{
+		return _arenas[_current]->getUsedSize();
+	}
+
+	inline size_t getHighWaterMark() const
+	{
+		return std::max(_arenas[0]->getHighWaterMark(), _arenas[1]->getHighWaterMark());
+	}
+
+private:
+	FrameAllocator(const FrameAllocator&);
+	FrameAllocator& operator=(const FrameAllocator&);
+
+private:
+	ArenaAllocator* _arenas[2];
+	size_t _current;
+};
+
+
+// stl adapter, deallocation is a no-op
+// containers using it must be recreated every frame, e.g. by swapping with an empty one,
+// because memory they hold is reclaimed two frames after the allocation
+template<class T>
+class FrameStlAllocator
+{
+public:
+	typedef T value_type;
+
+	FrameStlAllocator() {}
+	template<class U>
+	FrameStlAllocator(const FrameStlAllocator<U>&) {}
+
+	T* allocate(size_t count)
+	{
+		return static_cast<T*>(FrameAllocator::getInstance().allocMemory(count * sizeof(T), alignof(T)));
+	}
+
+	void deallocate(T*, size_t) {}
+
+	template<class U>
+	bool operator==(const FrameStlAllocator<U>&) const { return true; }
+	template<class U>
+	bool operator!=(const FrameStlAllocator<U>&) const { return false; }
+};
+
+
+template<class T>
+using FrameVector = std::vector<T, FrameStlAllocator<T>>;
+
+#endif
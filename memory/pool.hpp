@@ -0,0 +1,169 @@
+#ifndef __FBE_POOL_HPP__
+#define __FBE_POOL_HPP__
+
+#include <cstdlib>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+#include <unordered_map>
+#include <assert.h>
+#include "memory/allocation_tracker.hpp"
+
+#if defined(_MSC_VER)
+#include <malloc.h>
+#endif
+
+#define POOL_NO_CHUNK 0xffffffffu
+
+// typed pool of objects of the same size
+// chunks are carved from pages, a new page is added when all chunks are in use, pages are never moved,
+// so pointers to live objects stay valid while the pool grows
+// each page is aligned to its (power of two) size, so the page holding a pointer is found by masking
+// free chunks keep 32-bit index of the next free chunk
+template<class T>
+class Pool
+{
+public:
+	Pool(size_t minChunksPerPage) : _firstFreeChunk(POOL_NO_CHUNK), _allocatedCount(0)
+	{
+		assert(minChunksPerPage > 0);
+		_chunkSize = sizeof(T) > sizeof(uint32_t) ? sizeof(T) : sizeof(uint32_t);
+		size_t alignment = alignof(T) > alignof(uint32_t) ? alignof(T) : alignof(uint32_t);
+		_chunkSize = (_chunkSize + alignment - 1) / alignment * alignment;
+		_pageSize = alignment;
+		while (_pageSize < _chunkSize * (minChunksPerPage > 0 ? minChunksPerPage : 1))
+			_pageSize <<= 1;
+		_chunksPerPage = _pageSize / _chunkSize;
+	}
+
+	// objects still alive are not destroyed, only their memory is released
+	~Pool()
+	{
+		for (size_t i = 0; i < _pages.size(); ++i)
+			freePage(_pages[i]);
+		_pages.clear();
+	}
+
+	template<class... Args>
+	inline T* create(Args&&... args)
+	{
+		return new (allocMemory()) T(std::forward<Args>(args)...);
+	}
+
+	inline void destroy(T* object)
+	{
+		assert(owns(object));
+		object->~T();
+		dealloc(object);
+	}
+
+	// O(1), also rejects pointers into the middle of a chunk
+	inline bool owns(const T* object) const
+	{
+		uintptr_t address = reinterpret_cast<uintptr_t>(object);
+		uintptr_t pageAddress = address & ~(uintptr_t)(_pageSize - 1);
+		if (_pageIndices.find(pageAddress) == _pageIndices.end())
+			return false;
+		size_t offset = address - pageAddress;
+		return offset % _chunkSize == 0 && offset / _chunkSize < _chunksPerPage;
+	}
+
+	inline size_t getAllocatedCount() const
+	{
+		return _allocatedCount;
+	}
+
+	inline size_t getCapacity() const
+	{
+		return _pages.size() * _chunksPerPage;
+	}
+
+private:
+	inline unsigned char* getChunk(uint32_t index) const
+	{
+		return _pages[index / _chunksPerPage] + (index % _chunksPerPage) * _chunkSize;
+	}
+
+	inline uint32_t getChunkIndex(void* memory) const
+	{
+		uintptr_t address = reinterpret_cast<uintptr_t>(memory);
+		uintptr_t pageAddress = address & ~(uintptr_t)(_pageSize - 1);
+		uint32_t pageIndex = _pageIndices.find(pageAddress)->second;
+		return pageIndex * (uint32_t)_chunksPerPage + (uint32_t)((address - pageAddress) / _chunkSize);
+	}
+
+	inline void* allocMemory()
+	{
+		if (_firstFreeChunk == POOL_NO_CHUNK)
+			addPage();
+		unsigned char* chunk = getChunk(_firstFreeChunk);
+		_firstFreeChunk = *reinterpret_cast<uint32_t*>(chunk);
+		++_allocatedCount;
+		return chunk;
+	}
+
+	inline void dealloc(void* memory)
+	{
+		assert(_allocatedCount > 0);
+		--_allocatedCount;
+		*static_cast<uint32_t*>(memory) = _firstFreeChunk;
+		_firstFreeChunk = getChunkIndex(memory);
+	}
+
+	void addPage()
+	{
+		assert((_pages.size() + 1) * _chunksPerPage < POOL_NO_CHUNK);
+		unsigned char* page = allocPage();
+		uint32_t pageIndex = (uint32_t)_pages.size();
+		_pages.push_back(page);
+		_pageIndices[reinterpret_cast<uintptr_t>(page)] = pageIndex;
+		// thread the page so that chunks are handed out in address order
+		uint32_t firstIndex = pageIndex * (uint32_t)_chunksPerPage;
+		for (size_t i = _chunksPerPage; i-- > 0;)
+		{
+			*reinterpret_cast<uint32_t*>(page + i * _chunkSize) = _firstFreeChunk;
+			_firstFreeChunk = firstIndex + (uint32_t)i;
+		}
+	}
+
+	// throws std::bad_alloc like the operator new the pool stands in for
+	unsigned char* allocPage() const
+	{
+		TRACK_ALLOCATION(_pageSize);
+#if defined(_MSC_VER)
+		void* page = _aligned_malloc(_pageSize, _pageSize);
+		if (page == nullptr)
+			throw std::bad_alloc();
+#else
+		void* page = nullptr;
+		if (posix_memalign(&page, _pageSize < sizeof(void*) ? sizeof(void*) : _pageSize, _pageSize) != 0)
+			throw std::bad_alloc();
+#endif
+		return static_cast<unsigned char*>(page);
+	}
+
+	void freePage(unsigned char* page) const
+	{
+#if defined(_MSC_VER)
+		_aligned_free(page);
+#else
+		free(page);
+#endif
+	}
+
+private:
+	Pool(const Pool&);
+	Pool& operator=(const Pool&);
+
+private:
+	size_t _chunkSize;
+	size_t _pageSize;
+	size_t _chunksPerPage;
+	uint32_t _firstFreeChunk;
+	size_t _allocatedCount;
+	std::vector<unsigned char*> _pages;
+	std::unordered_map<uintptr_t, uint32_t> _pageIndices;
+};
+
+#endif
@@ -0,0 +1,114 @@
+#include "frame_stats.h"
+#include "scope_profiler.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+FrameStats::FrameStats() : _framesCount(0), _historyIndex(0)
+{
+	_frameHistory.reserve(FRAME_STATS_HISTORY_SIZE);
+	_sorted.reserve(FRAME_STATS_HISTORY_SIZE);
+	memset(&_frameSummary, 0, sizeof(_frameSummary));
+	_lines.resize(1);
+}
+
+void FrameStats::track(const char* zoneName, const char* label)
+{
+	Track track;
+	track.zoneName = zoneName;
+	track.label = label;
+	track.history.reserve(FRAME_STATS_HISTORY_SIZE);
+	memset(&track.summary, 0, sizeof(track.summary));
+	_tracks.push_back(track);
+	_lines.resize(_tracks.size() + 1);
+}
+
+void FrameStats::onFrameCollected()
+{
+	// the history is a ring once it's full
+	const std::vector<ProfilerZoneStats>& zones = ScopeProfiler::getFrameStats();
+	bool full = _frameHistory.size() == FRAME_STATS_HISTORY_SIZE;
+	if (full)
+		_frameHistory[_historyIndex] = (float)ScopeProfiler::getFrameSeconds();
+	else
+		_frameHistory.push_back((float)ScopeProfiler::getFrameSeconds());
+	for (size_t i = 0; i < _tracks.size(); ++i)
+	{
+		Track& track = _tracks[i];
+		float seconds = 0;
+		for (size_t j = 0; j < zones.size(); ++j)
+			if (track.zoneName == zones[j].zone->name)
+				seconds += (float)zones[j].totalSeconds;
+		if (full)
+			track.history[_historyIndex] = seconds;
+		else
+			track.history.push_back(seconds);
+	}
+	_historyIndex = (_historyIndex + 1) % FRAME_STATS_HISTORY_SIZE;
+
+	if (++_framesCount % FRAME_STATS_REFRESH_FRAMES != 0)
+		return;
+
+	summarize(_frameHistory, _frameSummary);
+	formatLine(0, "frame", _frameSummary);
+	for (size_t i = 0; i < _tracks.size(); ++i)
+	{
+		summarize(_tracks[i].history, _tracks[i].summary);
+		formatLine(i + 1, _tracks[i].label.c_str(), _tracks[i].summary);
+	}
+}
+
+const FrameStatsSummary& FrameStats::getFrameSummary() const
+{
+	return _frameSummary;
+}
+
+size_t FrameStats::getTracksCount() const
+{
+	return _tracks.size();
+}
+
+const FrameStatsSummary& FrameStats::getTrackSummary(size_t track) const
+{
+	return _tracks[track].summary;
+}
+
+const std::vector<std::string>& FrameStats::getLines() const
+{
+	return _lines;
+}
+
+// nearest rank: index ceil(p * n) - 1 of the sorted samples
+static size_t getPercentileIndex(size_t count, size_t percent)
+{
+	size_t rank = (count * percent + 99) / 100;
+	return rank > 0 ? std::min(rank, count) - 1 : 0;
+}
+
+void FrameStats::summarize(const std::vector<float>& history, FrameStatsSummary& summary)
+{
+	if (history.empty())
+		return;
+
+	_sorted.assign(history.begin(), history.end());
+	std::sort(_sorted.begin(), _sorted.end());
+	size_t last = _sorted.size() - 1;
+	float sum = 0;
+	for (size_t i = 0; i < _sorted.size(); ++i)
+		sum += _sorted[i];
+
+	summary.min = _sorted[0];
+	summary.avg = sum / (float)_sorted.size();
+	summary.p95 = _sorted[getPercentileIndex(_sorted.size(), 95)];
+	summary.p99 = _sorted[getPercentileIndex(_sorted.size(), 99)];
+	summary.max = _sorted[last];
+}
+
+void FrameStats::formatLine(size_t line, const char* label, const FrameStatsSummary& summary)
+{
+	char text[128];
+	snprintf(text, sizeof(text), "%-8s min %6.2f  avg %6.2f  p95 %6.2f  p99 %6.2f  max %6.2f ms", label,
+		summary.min * 1e3f, summary.avg * 1e3f, summary.p95 * 1e3f, summary.p99 * 1e3f, summary.max * 1e3f);
+	// assigned in place, the string keeps its buffer
+	_lines[line] = text;
+}
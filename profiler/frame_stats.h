@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#define FRAME_STATS_HISTORY_SIZE 256
+// summaries and lines are refreshed this often, so the text stays readable and isn't reformatted every frame
+#define FRAME_STATS_REFRESH_FRAMES 15
+
+struct FrameStatsSummary
+{
+	float min;
+	float avg;
+	float p95;
+	float p99;
+	float max;
+};
+
+// rolling history of frame times and of the time spent in chosen profiler zones
+class FrameStats
+{
+public:
+	FrameStats();
+
+	// zone times are summed over all calls and threads in a frame
+	void track(const char* zoneName, const char* label);
+
+	// takes the frame just collected by ScopeProfiler::endFrame
+	void onFrameCollected();
+
+	// in seconds, over the history
+	const FrameStatsSummary& getFrameSummary() const;
+	size_t getTracksCount() const;
+	const FrameStatsSummary& getTrackSummary(size_t track) const;
+
+	// text breakdown in milliseconds, reformatted only on refresh
+	const std::vector<std::string>& getLines() const;
+
+private:
+	struct Track
+	{
+		std::string zoneName;
+		std::string label;
+		std::vector<float> history;
+		FrameStatsSummary summary;
+	};
+
+	void summarize(const std::vector<float>& history, FrameStatsSummary& summary);
+	void formatLine(size_t line, const char* label, const FrameStatsSummary& summary);
+
+private:
+	size_t _framesCount;
+	size_t _historyIndex;
+	std::vector<float> _frameHistory;
+	FrameStatsSummary _frameSummary;
+	std::vector<Track> _tracks;
+
+	std::vector<float> _sorted;
+	std::vector<std::string> _lines;
+};
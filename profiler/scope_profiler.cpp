@@ -1,34 +1,235 @@
 #include "scope_profiler.h"
+#include <stdio.h>
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+
+namespace
+{
 
-#if defined(__INANITY_WINDOWS)
+	typedef std::chrono::steady_clock CalibrationClock;
 
-#include <Windows.h>
-#include <stdio.h>
+	// collector state, touched only by the thread calling endFrame, except the threads list
+	struct ProfilerState
+	{
+		std::mutex threadsMutex;
+		std::vector<ProfilerThreadBuffer*> threads;
+
+		uint64_t startTicks;
+		CalibrationClock::time_point startTime;
+		uint64_t frameBeginTicks;
+		uint64_t frameEndTicks;
+		double frameSeconds;
+
+		// every zone ever seen keeps its slot, so aggregation doesn't allocate in steady state
+		std::unordered_map<const ProfilerZone*, size_t> zoneSlots;
+		std::vector<ProfilerZoneStats> zones;
+		std::vector<uint64_t> zoneTicks;
+		std::vector<uint64_t> zoneMaxTicks;
+
+		std::vector<ProfilerZoneStats> frameStats;
+		std::vector<ProfilerEvent> frameEvents;
 
-ScopeProfiler::ScopeProfiler(const char* codeAlias, const char* fileName, unsigned long lineNumber): _codeAlias(codeAlias), _fileName(fileName), _lineNumber(lineNumber)
+		ProfilerState() : startTicks(ScopeProfiler::now()), startTime(CalibrationClock::now()), frameSeconds(0)
+		{
+			frameBeginTicks = startTicks;
+			frameEndTicks = startTicks;
+		}
+	};
+
+	ProfilerState& getState()
+	{
+		static ProfilerState state;
+		return state;
+	}
+
+	void addSample(ProfilerState& state, const ProfilerZone* zone, uint32_t depth, uint64_t ticks)
+	{
+		std::unordered_map<const ProfilerZone*, size_t>::iterator i = state.zoneSlots.find(zone);
+		size_t slot;
+		if (i == state.zoneSlots.end())
+		{
+			slot = state.zones.size();
+			state.zoneSlots[zone] = slot;
+			ProfilerZoneStats stats = { zone, 0, depth, 0, 0 };
+			state.zones.push_back(stats);
+			state.zoneTicks.push_back(0);
+			state.zoneMaxTicks.push_back(0);
+		}
+		else
+			slot = i->second;
+
+		ProfilerZoneStats& stats = state.zones[slot];
+		if (stats.calls == 0)
+			stats.depth = depth;
+		++stats.calls;
+		state.zoneTicks[slot] += ticks;
+		if (ticks > state.zoneMaxTicks[slot])
+			state.zoneMaxTicks[slot] = ticks;
+	}
+
+	void collectRecords(ProfilerState& state, uint32_t threadIndex, std::vector<ProfilerRecord>& openZones,
+		const ProfilerRecord* records, size_t tail, size_t head)
+	{
+		for (size_t i = tail; i != head; ++i)
+		{
+			const ProfilerRecord& record = records[i % PROFILER_THREAD_BUFFER_SIZE];
+			if (record.begin)
+			{
+				openZones.push_back(record);
+				continue;
+			}
+			if (openZones.empty())
+				continue;
+
+			ProfilerRecord begin = openZones.back();
+			openZones.pop_back();
+			ProfilerEvent event = { begin.zone, threadIndex, (uint32_t)openZones.size(), begin.ticks, record.ticks };
+			state.frameEvents.push_back(event);
+			addSample(state, begin.zone, event.depth, record.ticks - begin.ticks);
+		}
+	}
+
+}
+
+std::atomic<bool> ScopeProfiler::_enabled(true);
+thread_local ProfilerThreadBuffer* ScopeProfiler::_threadBuffer = nullptr;
+
+ProfilerThreadBuffer::ProfilerThreadBuffer(uint32_t threadIndex) : _head(0), _tail(0), _depth(0), _droppedCount(0), _threadIndex(threadIndex)
 {
-	__int64 countPerSecond = 0;
-	QueryPerformanceFrequency((LARGE_INTEGER*)&countPerSecond);
-	_secondsPerCount = 1.0f / (float)countPerSecond;
+	_openZones.reserve(PROFILER_MAX_DEPTH);
+	snprintf(_name, sizeof(_name), "thread %u", threadIndex);
+}
 
-	_start = 0;
-	QueryPerformanceCounter((LARGE_INTEGER*)&_start);
+ProfilerThreadBuffer* ScopeProfiler::registerThread()
+{
+	ProfilerState& state = getState();
+	std::lock_guard<std::mutex> lock(state.threadsMutex);
+	_threadBuffer = new ProfilerThreadBuffer((uint32_t)state.threads.size());
+	state.threads.push_back(_threadBuffer);
+	return _threadBuffer;
 }
 
+double ScopeProfiler::getSecondsPerTick()
+{
+#if defined(PROFILER_USE_TSC)
+	ProfilerState& state = getState();
+	uint64_t ticks = now() - state.startTicks;
+	double seconds = std::chrono::duration<double>(CalibrationClock::now() - state.startTime).count();
+	// too early to tell, assume some GHz
+	if (ticks < 1000000 || seconds <= 0)
+		return 1e-9 / 3;
+	return seconds / (double)ticks;
+#elif defined(_MSC_VER)
+	return (double)std::chrono::steady_clock::period::num / (double)std::chrono::steady_clock::period::den;
+#else
+	return 1e-9;
+#endif
+}
 
-ScopeProfiler::~ScopeProfiler()
+void ScopeProfiler::setEnabled(bool enabled)
 {
-	__int64 finish = 0;
-	QueryPerformanceCounter((LARGE_INTEGER*)&finish);
+	_enabled.store(enabled, std::memory_order_relaxed);
+}
 
-	float dt = (finish - _start) * _secondsPerCount;
-	processResult(dt);
+bool ScopeProfiler::isEnabled()
+{
+	return _enabled.load(std::memory_order_relaxed);
 }
 
+void ScopeProfiler::setThreadName(const char* name)
+{
+	ProfilerThreadBuffer* buffer = getThreadBuffer();
+	std::lock_guard<std::mutex> lock(getState().threadsMutex);
+	snprintf(buffer->_name, sizeof(buffer->_name), "%s", name);
+}
 
-void ScopeProfiler::processResult(float dt)
+size_t ScopeProfiler::getThreadsCount()
 {
-	printf("time for %s (%s at %u): %f\n", _codeAlias, _fileName, _lineNumber, dt);
+	ProfilerState& state = getState();
+	std::lock_guard<std::mutex> lock(state.threadsMutex);
+	return state.threads.size();
 }
 
-#endif
+const char* ScopeProfiler::getThreadName(size_t threadIndex)
+{
+	ProfilerState& state = getState();
+	std::lock_guard<std::mutex> lock(state.threadsMutex);
+	return threadIndex < state.threads.size() ? state.threads[threadIndex]->_name : "";
+}
+
+void ScopeProfiler::endFrame()
+{
+	ProfilerState& state = getState();
+
+	for (size_t i = 0; i < state.zones.size(); ++i)
+	{
+		state.zones[i].calls = 0;
+		state.zoneTicks[i] = 0;
+		state.zoneMaxTicks[i] = 0;
+	}
+	state.frameEvents.clear();
+
+	{
+		std::lock_guard<std::mutex> lock(state.threadsMutex);
+		for (size_t i = 0; i < state.threads.size(); ++i)
+		{
+			ProfilerThreadBuffer& buffer = *state.threads[i];
+			size_t tail = buffer._tail.load(std::memory_order_relaxed);
+			size_t head = buffer._head.load(std::memory_order_acquire);
+			collectRecords(state, buffer._threadIndex, buffer._openZones, buffer._records, tail, head);
+			buffer._tail.store(head, std::memory_order_release);
+		}
+	}
+
+	double secondsPerTick = getSecondsPerTick();
+	state.frameStats.clear();
+	for (size_t i = 0; i < state.zones.size(); ++i)
+	{
+		if (state.zones[i].calls == 0)
+			continue;
+		ProfilerZoneStats stats = state.zones[i];
+		stats.totalSeconds = (double)state.zoneTicks[i] * secondsPerTick;
+		stats.maxSeconds = (double)state.zoneMaxTicks[i] * secondsPerTick;
+		state.frameStats.push_back(stats);
+	}
+
+	state.frameBeginTicks = state.frameEndTicks;
+	state.frameEndTicks = now();
+	state.frameSeconds = (double)(state.frameEndTicks - state.frameBeginTicks) * secondsPerTick;
+}
+
+const std::vector<ProfilerZoneStats>& ScopeProfiler::getFrameStats()
+{
+	return getState().frameStats;
+}
+
+uint64_t ScopeProfiler::getFrameBeginTicks()
+{
+	return getState().frameBeginTicks;
+}
+
+uint64_t ScopeProfiler::getFrameEndTicks()
+{
+	return getState().frameEndTicks;
+}
+
+const std::vector<ProfilerEvent>& ScopeProfiler::getFrameEvents()
+{
+	return getState().frameEvents;
+}
+
+double ScopeProfiler::getFrameSeconds()
+{
+	return getState().frameSeconds;
+}
+
+size_t ScopeProfiler::getDroppedCount()
+{
+	ProfilerState& state = getState();
+	std::lock_guard<std::mutex> lock(state.threadsMutex);
+	size_t count = 0;
+	for (size_t i = 0; i < state.threads.size(); ++i)
+		count += state.threads[i]->_droppedCount.load(std::memory_order_relaxed);
+	return count;
+}
@@ -1,30 +1,222 @@
-#if defined(__INANITY_WINDOWS)
-
 #pragma once
 
-#define SCOPE_PROFILER( NAME ) ScopeProfiler scopeProfiler( #NAME , __FILE__ , __LINE__ );
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <vector>
 
-class ScopeProfiler
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define PROFILER_USE_TSC
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define PROFILER_USE_TSC
+#elif defined(_MSC_VER)
+// steady clock is QueryPerformanceCounter there
+#include <chrono>
+#else
+#include <time.h>
+#endif
+
+// records per thread which the collector hasn't taken yet, frames with more are cut
+#define PROFILER_THREAD_BUFFER_SIZE (size_t)16384
+#define PROFILER_MAX_DEPTH 64
+#define PROFILER_THREAD_NAME_SIZE 32
+
+#define SCOPE_PROFILER_CONCAT_IMPL( A, B ) A##B
+#define SCOPE_PROFILER_CONCAT( A, B ) SCOPE_PROFILER_CONCAT_IMPL( A, B )
+
+// define FIRSTBLOOD_NO_PROFILER to compile the markers out
+#if !defined(FIRSTBLOOD_NO_PROFILER)
+
+#if defined(FIRSTBLOOD_TRACK_ALLOCATIONS)
+#include "memory/allocation_tracker.hpp"
+// allocations are attributed to the innermost zone
+#define SCOPE_PROFILER_ALLOCATION_SCOPE( ZONE ) AllocationScope SCOPE_PROFILER_CONCAT( allocationScope, __LINE__ )( ZONE );
+#else
+#define SCOPE_PROFILER_ALLOCATION_SCOPE( ZONE )
+#endif
+
+#define SCOPE_PROFILER( NAME ) \
+	static const ProfilerZone SCOPE_PROFILER_CONCAT( profilerZone, __LINE__ ) = { #NAME, __FILE__, __LINE__ }; \
+	ScopeProfiler SCOPE_PROFILER_CONCAT( scopeProfiler, __LINE__ )( &SCOPE_PROFILER_CONCAT( profilerZone, __LINE__ ) ); \
+	SCOPE_PROFILER_ALLOCATION_SCOPE( &SCOPE_PROFILER_CONCAT( profilerZone, __LINE__ ) )
+
+#else
+
+#define SCOPE_PROFILER( NAME )
+
+#endif
+
+// static description of a profiled scope
+struct ProfilerZone
+{
+	const char* name;
+	const char* fileName;
+	unsigned long lineNumber;
+};
+
+struct ProfilerRecord
+{
+	const ProfilerZone* zone;
+	uint64_t ticks;
+	bool begin;
+};
+
+// zone aggregated over the last collected frame
+struct ProfilerZoneStats
+{
+	const ProfilerZone* zone;
+	uint32_t calls;
+	uint32_t depth;
+	double totalSeconds;
+	double maxSeconds;
+};
+
+// completed zone of the last collected frame
+struct ProfilerEvent
+{
+	const ProfilerZone* zone;
+	uint32_t threadIndex;
+	uint32_t depth;
+	uint64_t startTicks;
+	uint64_t endTicks;
+};
+
+// single producer (owning thread), single consumer (collector) ring of begin/end records
+class ProfilerThreadBuffer
 {
 public:
-	ScopeProfiler(const char* codeAlias, const char* fileName, unsigned long lineNumber);
-	~ScopeProfiler();
+	ProfilerThreadBuffer(uint32_t threadIndex);
 
-protected:
-	virtual void processResult(float dt);
+	// begin is written only if there is room for it and for the ends of all open zones,
+	// so an end record always fits and nesting stays consistent
+	inline bool pushBegin(const ProfilerZone* zone, uint64_t ticks)
+	{
+		size_t head = _head.load(std::memory_order_relaxed);
+		size_t used = head - _tail.load(std::memory_order_acquire);
+		if (used + _depth + 2 > PROFILER_THREAD_BUFFER_SIZE || _depth >= PROFILER_MAX_DEPTH)
+		{
+			_droppedCount.store(_droppedCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			return false;
+		}
+		ProfilerRecord& record = _records[head % PROFILER_THREAD_BUFFER_SIZE];
+		record.zone = zone;
+		record.ticks = ticks;
+		record.begin = true;
+		++_depth;
+		_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
 
-private:
-	const char* _codeAlias;
-	const char* _fileName;
-	unsigned long _lineNumber;
+	inline void pushEnd(uint64_t ticks)
+	{
+		size_t head = _head.load(std::memory_order_relaxed);
+		ProfilerRecord& record = _records[head % PROFILER_THREAD_BUFFER_SIZE];
+		record.zone = nullptr;
+		record.ticks = ticks;
+		record.begin = false;
+		--_depth;
+		_head.store(head + 1, std::memory_order_release);
+	}
 
-	float _secondsPerCount;
+private:
+	friend class ScopeProfiler;
 
-	__int64 _start;
+	ProfilerRecord _records[PROFILER_THREAD_BUFFER_SIZE];
+	std::atomic<size_t> _head;
+	std::atomic<size_t> _tail;
+	// producer side
+	uint32_t _depth;
+	std::atomic<uint32_t> _droppedCount;
+	// collector side
+	uint32_t _threadIndex;
+	char _name[PROFILER_THREAD_NAME_SIZE];
+	std::vector<ProfilerRecord> _openZones;
 };
 
+// hierarchical scope profiler, cheap enough to stay in production builds
+// markers write timestamped begin/end records to the thread's ring buffer,
+// the main thread collects and aggregates all buffers once per frame in endFrame
+class ScopeProfiler
+{
+public:
+	inline ScopeProfiler(const ProfilerZone* zone) : _buffer(nullptr)
+	{
+		if (!_enabled.load(std::memory_order_relaxed))
+			return;
+		ProfilerThreadBuffer* buffer = getThreadBuffer();
+		if (buffer->pushBegin(zone, now()))
+			_buffer = buffer;
+	}
+
+	// for zones which can't be scoped, e.g. opened and closed by scripts
+	// every begin which returned true needs an end on the same thread
+	inline static bool beginZone(const ProfilerZone* zone)
+	{
+		return _enabled.load(std::memory_order_relaxed) && getThreadBuffer()->pushBegin(zone, now());
+	}
+
+	inline static void endZone()
+	{
+		getThreadBuffer()->pushEnd(now());
+	}
+
+	inline ~ScopeProfiler()
+	{
+		if (_buffer != nullptr)
+			_buffer->pushEnd(now());
+	}
+
+	// TSC where available, monotonic clock otherwise
+	inline static uint64_t now()
+	{
+#if defined(PROFILER_USE_TSC)
+		return __rdtsc();
+#elif defined(_MSC_VER)
+		return (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
 #else
+		timespec time;
+		clock_gettime(CLOCK_MONOTONIC, &time);
+		return (uint64_t)time.tv_sec * 1000000000ull + (uint64_t)time.tv_nsec;
+#endif
+	}
 
-#define SCOPE_PROFILER( NAME )
+	// TSC rate is measured against the monotonic clock since the start, so it gets more precise with time
+	static double getSecondsPerTick();
+
+	static void setEnabled(bool enabled);
+	static bool isEnabled();
 
-#endif
\ No newline at end of file
+	// name of the calling thread for reports, threads are numbered in order of their first zone
+	static void setThreadName(const char* name);
+	static size_t getThreadsCount();
+	static const char* getThreadName(size_t threadIndex);
+
+	// collects records of all threads and aggregates them as the last frame
+	static void endFrame();
+	static const std::vector<ProfilerZoneStats>& getFrameStats();
+	static const std::vector<ProfilerEvent>& getFrameEvents();
+	static double getFrameSeconds();
+	// bounds of the last collected frame, in ticks
+	static uint64_t getFrameBeginTicks();
+	static uint64_t getFrameEndTicks();
+	// begin records lost because of full buffers since the start
+	static size_t getDroppedCount();
+
+private:
+	inline static ProfilerThreadBuffer* getThreadBuffer()
+	{
+		ProfilerThreadBuffer* buffer = _threadBuffer;
+		return buffer != nullptr ? buffer : registerThread();
+	}
+
+	// buffers are kept after their threads exit, threads are expected to live as long as the engine
+	static ProfilerThreadBuffer* registerThread();
+
+private:
+	ProfilerThreadBuffer* _buffer;
+
+	static std::atomic<bool> _enabled;
+	static thread_local ProfilerThreadBuffer* _threadBuffer;
+};
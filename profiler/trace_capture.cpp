@@ -0,0 +1,118 @@
+#include "trace_capture.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace
+{
+
+	void writeString(FILE* file, const char* string)
+	{
+		fputc('"', file);
+		for (const char* c = string; *c; ++c)
+		{
+			if (*c == '"' || *c == '\\')
+				fputc('\\', file);
+			if ((unsigned char)*c >= 0x20)
+				fputc(*c, file);
+		}
+		fputc('"', file);
+	}
+
+}
+
+TraceCapture::TraceCapture() : _framesLeft(0)
+{
+}
+
+void TraceCapture::start(const char* fileName, size_t framesCount)
+{
+	_fileName = fileName;
+	_framesLeft = framesCount > 0 ? framesCount : 1;
+	_frames.clear();
+	_events.clear();
+}
+
+void TraceCapture::startFromEnvironment()
+{
+	const char* fileName = getenv("FIRSTBLOOD_TRACE");
+	if (fileName == nullptr || *fileName == 0)
+		return;
+	const char* frames = getenv("FIRSTBLOOD_TRACE_FRAMES");
+	start(fileName, frames != nullptr ? (size_t)atol(frames) : TRACE_CAPTURE_DEFAULT_FRAMES);
+}
+
+bool TraceCapture::isCapturing() const
+{
+	return _framesLeft > 0;
+}
+
+void TraceCapture::onFrameCollected()
+{
+	if (_framesLeft == 0)
+		return;
+
+	Frame frame = { ScopeProfiler::getFrameBeginTicks(), ScopeProfiler::getFrameEndTicks() };
+	_frames.push_back(frame);
+	const std::vector<ProfilerEvent>& events = ScopeProfiler::getFrameEvents();
+	_events.insert(_events.end(), events.begin(), events.end());
+
+	if (--_framesLeft > 0)
+		return;
+
+	if (write())
+		printf("trace of %u frames written to %s\n", (unsigned)_frames.size(), _fileName.c_str());
+	else
+		printf("can't write trace to %s\n", _fileName.c_str());
+	_frames.clear();
+	_events.clear();
+}
+
+bool TraceCapture::write() const
+{
+	FILE* file = fopen(_fileName.c_str(), "w");
+	if (file == nullptr)
+		return false;
+
+	// timestamps are microseconds from the start of the first frame
+	uint64_t baseTicks = _frames.empty() ? 0 : _frames[0].beginTicks;
+	double microsecondsPerTick = ScopeProfiler::getSecondsPerTick() * 1e6;
+	size_t threadsCount = ScopeProfiler::getThreadsCount();
+	// frames get the lane after all threads
+	size_t framesLane = threadsCount;
+
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"firstblood\"}}");
+	for (size_t i = 0; i <= threadsCount; ++i)
+	{
+		fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", (unsigned)i);
+		writeString(file, i < threadsCount ? ScopeProfiler::getThreadName(i) : "frames");
+		fprintf(file, "}}");
+		fprintf(file, ",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"sort_index\":%u}}",
+			(unsigned)i, (unsigned)(i < threadsCount ? i + 1 : 0));
+	}
+
+	for (size_t i = 0; i < _frames.size(); ++i)
+	{
+		const Frame& frame = _frames[i];
+		fprintf(file, ",\n{\"name\":\"frame %u\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+			(unsigned)i, (unsigned)framesLane,
+			(double)(int64_t)(frame.beginTicks - baseTicks) * microsecondsPerTick,
+			(double)(frame.endTicks - frame.beginTicks) * microsecondsPerTick);
+	}
+
+	for (size_t i = 0; i < _events.size(); ++i)
+	{
+		const ProfilerEvent& event = _events[i];
+		fprintf(file, ",\n{\"name\":");
+		writeString(file, event.zone->name);
+		fprintf(file, ",\"cat\":\"zone\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"file\":",
+			(unsigned)event.threadIndex,
+			(double)(int64_t)(event.startTicks - baseTicks) * microsecondsPerTick,
+			(double)(event.endTicks - event.startTicks) * microsecondsPerTick);
+		writeString(file, event.zone->fileName);
+		fprintf(file, ",\"line\":%lu}}", event.zone->lineNumber);
+	}
+
+	fprintf(file, "\n]}\n");
+	return fclose(file) == 0;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include "scope_profiler.h"
+
+#define TRACE_CAPTURE_DEFAULT_FRAMES 120
+
+// records profiler events of several consecutive frames and writes them
+// in Chrome trace format (chrome://tracing, ui.perfetto.dev): a lane per thread plus a lane of frames
+class TraceCapture
+{
+public:
+	TraceCapture();
+
+	// captures the next framesCount frames, a capture in progress is restarted
+	void start(const char* fileName, size_t framesCount = TRACE_CAPTURE_DEFAULT_FRAMES);
+	// FIRSTBLOOD_TRACE=<file> starts a capture, FIRSTBLOOD_TRACE_FRAMES overrides the frames count
+	void startFromEnvironment();
+	bool isCapturing() const;
+
+	// takes the frame just collected by ScopeProfiler::endFrame, writes the file after the last one
+	void onFrameCollected();
+
+private:
+	struct Frame
+	{
+		uint64_t beginTicks;
+		uint64_t endTicks;
+	};
+
+	bool write() const;
+
+private:
+	std::string _fileName;
+	size_t _framesLeft;
+	std::vector<Frame> _frames;
+	std::vector<ProfilerEvent> _events;
+};
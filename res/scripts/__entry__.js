@@ -30,7 +30,7 @@ if (!this.initialized)
 	require('stdlib');
 	var engineDispatcher = new EventDispatcher();
 	// either there is some fuck-up with global scope's prototype or I don't know a shit about js
-	this.addListener = function(eventType, listener) { engineDispatcher.addListener(eventType, listener) };
+	this.addListener = function(eventType, listener, name) { engineDispatcher.addListener(eventType, listener, name) };
 	this.removeListener = function(eventType, listener) { engineDispatcher.removeListener(eventType, listener) };
 	this.dispatch = function(event) { engineDispatcher.dispatch(event) };
 	
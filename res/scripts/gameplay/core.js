@@ -60,7 +60,12 @@ GameplayRegistry.prototype = {
 	{
 		this.updating = true;
 		for (var i = 0, l = this.list.length; i < l; ++i)
-			this.list[i].update(dt);
+		{
+			var object = this.list[i];
+			Engine.Profiler.begin(object.profilerName || "GameplayObject");
+			object.update(dt);
+			Engine.Profiler.end();
+		}
 
 		this.updating = false;
 		for (i = 0, l = this.toBeRemoved.length; i < l; ++i)
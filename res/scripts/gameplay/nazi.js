@@ -1,13 +1,14 @@
 require('math/vec2');
 
-var Nazi = function(GameplayRegistry, Player, DebugDrawer) {};
+var Nazi = function(GameplayRegistry, DebugDrawer) {};
 Nazi.prototype = {
 
 	init: function(position, spawner)
 	{
 		this.spawner = spawner;
 		this.rvoAgent = Engine.Rvo.create(position, this.uid);
-		this.rvoAgent.setMaxSpeed(0.5 + Math.random());
+		Engine.Rvo.setMaxSpeed(this.rvoAgent, 0.5 + Math.random());
+		Engine.Rvo.setFlowField(this.rvoAgent, spawner.flowField);
 	},
 
 	fini: function()
@@ -16,20 +17,10 @@ Nazi.prototype = {
 		this.spawner.naziKilled();
 	},
 
-	update: function(dt)
-	{
-		if (this.alive)
-		{
-			var playerPosition = this.Player.getPosition();
-			var prefVelocity = vec2.sub(playerPosition, this.rvoAgent.getPosition());
-			this.rvoAgent.setPrefVelocity(prefVelocity);
-		}
-	},
-
 	debugDraw: function()
 	{
-		var position = this.rvoAgent.getPosition();
-		Engine.Painter.drawCircle(vec3.v(position[0], position[1], 0), this.rvoAgent.getRadius(), 0xff0000, 16);
+		var position = Engine.Rvo.getPosition(this.rvoAgent);
+		Engine.Painter.drawCircle(vec3.v(position[0], position[1], 0), Engine.Rvo.getRadius(this.rvoAgent), 0xff0000, 16);
 	}
 
 };
\ No newline at end of file
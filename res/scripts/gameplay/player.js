@@ -4,12 +4,15 @@ require('gameplay/projectile');
 var Player = function(GameplayRegistry, DebugDrawer, Injector) {};
 Player.prototype = {
 
+	// zone the registry reports update time under
+	profilerName: "Player",
+
 	init: function()
 	{
 		this.rvoAgent = Engine.Rvo.create(vec2.v(0, 0), this.uid);
 		this.maxSpeed = 2;
-		this.rvoAgent.setMaxSpeed(this.maxSpeed);
-		this.rvoAgent.setTimeHorizon(0.1);
+		Engine.Rvo.setMaxSpeed(this.rvoAgent, this.maxSpeed);
+		Engine.Rvo.setTimeHorizon(this.rvoAgent, 0.1);
 
 		this.weaponRecharge = 0;
 		this.playerPressesFire = false;
@@ -32,7 +35,7 @@ Player.prototype = {
 		var input = Engine.Input;
 		var vx = input.isKeyDown(65) ? -1 : (input.isKeyDown(68) ? 1 : 0);
 		var vy = input.isKeyDown(83) ? -1 : (input.isKeyDown(87) ? 1 : 0);
-		this.rvoAgent.setPrefVelocity(vec2.scale(vec2.v(vx, vy), this.maxSpeed));
+		Engine.Rvo.setPrefVelocity(this.rvoAgent, vec2.scale(vec2.v(vx, vy), this.maxSpeed));
 
 		if (this.weaponRecharge <= 0)
 		{
@@ -45,7 +48,7 @@ Player.prototype = {
 				var angle = Math.atan2(dy, dx);
 				angle += 0.12 * (1 - 2 * Math.random());
 				direction = vec3.normalize(vec2.to3(vec2.v(Math.cos(angle), Math.sin(angle)), 0));
-				this.Injector.create(Projectile, vec2.to3(this.rvoAgent.getPosition(), 0), direction, 5, this.rvoAgent);
+				this.Injector.create(Projectile, vec2.to3(Engine.Rvo.getPosition(this.rvoAgent), 0), direction, 5, this.rvoAgent);
 			}
 		}
 		else
@@ -56,13 +59,13 @@ Player.prototype = {
 
 	getPosition: function()
 	{
-		return this.rvoAgent.getPosition();
+		return Engine.Rvo.getPosition(this.rvoAgent);
 	},
 
 	debugDraw: function()
 	{
-		var position = this.rvoAgent.getPosition();
-		Engine.Painter.drawCircle(vec3.v(position[0], position[1], 0), this.rvoAgent.getRadius(), 0xffffff, 16);
+		var position = Engine.Rvo.getPosition(this.rvoAgent);
+		Engine.Painter.drawCircle(vec3.v(position[0], position[1], 0), Engine.Rvo.getRadius(this.rvoAgent), 0xffffff, 16);
 	}
 
 };
\ No newline at end of file
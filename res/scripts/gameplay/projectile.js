@@ -3,6 +3,9 @@ require('math/vec3');
 var Projectile = function(GameplayRegistry, DebugDrawer, Injector) {};
 Projectile.prototype = {
 
+	// zone the registry reports update time under
+	profilerName: "Projectile",
+
 	init: function(position, direction, speed, owner)
 	{
 		this.position = position;
@@ -1,12 +1,22 @@
 require('math/vec2');
 require('gameplay/nazi');
 
-var Spawner = function(GameplayRegistry, Injector) {};
+var Spawner = function(GameplayRegistry, Injector, Player) {};
 Spawner.prototype = {
 
+	// zone the registry reports update time under
+	profilerName: "Spawner",
+
 	init: function() 
 	{
 		this.nazisCount = 0;
+		// all nazis chase the player, so they share one navigation field
+		this.flowField = Engine.Rvo.createFlowField(vec2.v(-256, -256), 4, 128, 128);
+	},
+
+	fini: function()
+	{
+		Engine.Rvo.destroyFlowField(this.flowField);
 	},
 
 	naziKilled: function()
@@ -16,6 +26,9 @@ Spawner.prototype = {
 
 	update: function(dt)
 	{
+		var playerPosition = this.Player.getPosition();
+		this.flowField.setGoal(vec2.v(playerPosition[0], playerPosition[1]));
+
 		if (this.nazisCount < 256)
 		{
 			var spawnPoint = vec2.v(-100, 100 * (1 - 2 * Math.random()));
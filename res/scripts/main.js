@@ -12,6 +12,9 @@ var Main = function()
 {
 	Engine.Painter.setGlobalScale(0.3);
 	Engine.Rvo.setAgentDefaults(15.0, 8, 15.0, 1.5, 1.0);
+	// crowds off-screen are simulated cheaper: (level, distance, update period, max neighbors, steering only)
+	Engine.Rvo.setLodLevel(1, 150.0, 2, 4, false);
+	Engine.Rvo.setLodLevel(2, 300.0, 4, 0, true);
 
 	this.debugDrawer = new DebugDrawer();
 	this.gameplayRegistry = new GameplayRegistry();
@@ -26,10 +29,10 @@ var Main = function()
 
 	this.spawner = this.injector.create(Spawner);
 
-	global.addListener(Event.FRAME, bind(this.update, this));
-	global.addListener(Event.KEYBOARD, bind(this.handleKeyEvent, this));
-	global.addListener(Event.MOUSE_MOVE, bind(this.handleMouseMoveEvent, this));
-	global.addListener(Event.MOUSE_BUTTON, bind(this.handleMouseButtonEvent, this));
+	global.addListener(Event.FRAME, bind(this.update, this), "Main.update");
+	global.addListener(Event.KEYBOARD, bind(this.handleKeyEvent, this), "Main.handleKeyEvent");
+	global.addListener(Event.MOUSE_MOVE, bind(this.handleMouseMoveEvent, this), "Main.handleMouseMoveEvent");
+	global.addListener(Event.MOUSE_BUTTON, bind(this.handleMouseButtonEvent, this), "Main.handleMouseButtonEvent");
 	
 	this.uidCounter = 1;
 	this.agentsWithGoals = [];
@@ -75,6 +78,7 @@ Main.prototype = {
 		Engine.Painter.drawLine(vec3.v(0, 0, 0), vec3.v(0, 0, 5), 0x0000ff, 0.1);
 		
 		var position = this.player.getPosition();
+		Engine.Rvo.setLodFocus(vec2.v(position[0], position[1]));
 		Engine.Camera.setLookAtLH(vec3.v(0.3 * position[0], 0.3 * position[1], 100), vec3.fromValues(0.000001, 0, -1), vec3.fromValues(0, 1, 1));
 		//return;
 		/*
@@ -105,10 +109,10 @@ Main.prototype = {
 		{
 			var agentWithGoal = this.agentsWithGoals[i];
 			var agent = agentWithGoal[0];
-			//Engine.Space.raycast(agent.getPosition(), vec3.create(0, 0, 0), 1, agent);
+			//Engine.Space.raycast(Engine.Rvo.getPosition(agent), vec3.create(0, 0, 0), 1, agent);
 			var goal = agentWithGoal[1];
-			var toGoal = vec2.sub(goal, agent.getPosition());
-			agent.setPrefVelocity(vec2.scale(vec2.normalize(toGoal), agent.getMaxSpeed()));
+			var toGoal = vec2.sub(goal, Engine.Rvo.getPosition(agent));
+			Engine.Rvo.setPrefVelocity(agent, vec2.scale(vec2.normalize(toGoal), Engine.Rvo.getMaxSpeed(agent)));
 		}
 
 		if (128 > Engine.Rvo.getNumAgents())
@@ -123,7 +127,7 @@ Main.prototype = {
 		{
 			var agent = this.agentsWithGoals[i][0];
 			var hisGoal = this.agentsWithGoals[i][1];
-			var agentPosition = agent.getPosition();
+			var agentPosition = Engine.Rvo.getPosition(agent);
 			var toGoal = vec2.sub(hisGoal, agentPosition);
 			if (vec2.len(toGoal) < 1.0)
 			{
@@ -139,10 +143,10 @@ Main.prototype = {
 		for (var i = 0, l = this.agentsWithGoals.length; i < l; ++i) 
 		{
 			var agent = this.agentsWithGoals[i][0];
-			var agentPosition = agent.getPosition();
+			var agentPosition = Engine.Rvo.getPosition(agent);
 			var x = agentPosition[0];
 			var y = agentPosition[1];
-			var radius = agent.getRadius();
+			var radius = Engine.Rvo.getRadius(agent);
 			Engine.Painter.drawCircle([x, y, 0], radius, 0xffffff, 16);
 		}*/
 	}
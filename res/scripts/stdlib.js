@@ -74,6 +74,7 @@ this.bind = function(method, scope)
 this.EventDispatcher = function()
 {
 	this.mapEventToSubscribersList = {};
+	this.mapEventToListenerNames = {};
 };
 
 EventDispatcher.prototype = {
@@ -85,20 +86,28 @@ EventDispatcher.prototype = {
 		if (eventType in this.mapEventToSubscribersList)
 		{
 			var subscribers = this.mapEventToSubscribersList[eventType];
+			var names = this.mapEventToListenerNames[eventType];
 			for (var i = 0, l = subscribers.length; i < l; ++i)
 			{
+				Engine.Profiler.begin(names[i]);
 				var handled = subscribers[i](event);
+				Engine.Profiler.end();
 				result = result || handled;
 			}
 		}
 		return result;
 	},
 	
-	addListener: function(eventType, listener)
+	// name is what the listener's time is reported under, event type by default
+	addListener: function(eventType, listener, name)
 	{
 		if (!(eventType in this.mapEventToSubscribersList))
+		{
 			this.mapEventToSubscribersList[eventType] = [];
+			this.mapEventToListenerNames[eventType] = [];
+		}
 		this.mapEventToSubscribersList[eventType].push(listener);
+		this.mapEventToListenerNames[eventType].push(name || eventType);
 	},
 	
 	removeListener: function(eventType, listener)
@@ -118,6 +127,7 @@ EventDispatcher.prototype = {
 			else
 			{
 				subscribers.splice(index, 1);
+				this.mapEventToListenerNames[eventType].splice(index, 1);
 			}
 		}
 	}
@@ -135,6 +145,8 @@ this.Engine = {
 	Camera: engine.getCamera(),
 	Input: engine.getInput(),
 	SpatialIndex: engine.getSpatialIndex(),
+	// begin(name)/end() pairs show up as profiler zones, unclosed ones are closed when the script returns to the engine
+	Profiler: engine.getProfiler(),
 	
 	getTime: function() { return time.getTime(); }
 };
@@ -146,14 +158,15 @@ this.clearInterval = function(timerId) { time.destroyTimer(timerId); };
 
 Engine.Space = {
 	
-	raycast: function(origin, end, mask, skipEntity)
+	// skipAgent is rvo agent handle
+	raycast: function(origin, end, mask, skipAgent)
 	{
-		if (skipEntity)
+		if (skipAgent)
 		{
-			entityMask = skipEntity.getMask();
-			skipEntity.setMask(0);
+			entityMask = Engine.Rvo.getMask(skipAgent);
+			Engine.Rvo.setMask(skipAgent, 0);
 			result = Engine.SpatialIndex.raycast(origin, end, mask);
-			skipEntity.setMask(entityMask);
+			Engine.Rvo.setMask(skipAgent, entityMask);
 			return result;
 		}
 		else
@@ -176,6 +189,12 @@ Engine.Space = {
 		{
 			return Engine.SpatialIndex.getNeighbors(point, distance, mask, maxResultLength);
 		}
+	},
+
+	// last frame's traversal counters, in Spatial::QueryCounter order (all zero unless the engine counts them)
+	getQueryCounters: function()
+	{
+		return Engine.SpatialIndex.getQueryCounters();
 	}
 
 };
\ No newline at end of file
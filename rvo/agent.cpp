@@ -6,17 +6,29 @@
 namespace RVO 
 {
 	
-	Agent::Agent() : maxNeighbors(0), maxSpeed(0.0f), neighborDist(0.0f), radius(0.0f), timeHorizon(0.0f), immobilized(false), mask(1) {}
+	Agent::Agent() : maxNeighbors(0), maxSpeed(0.0f), neighborDist(0.0f), radius(0.0f), timeHorizon(0.0f), immobilized(false), mask(1), flowField(nullptr),
+		_sleeping(false), _idleSteps(0) {}
 
 	Agent::~Agent() {};
 
-	void Agent::computeNewVelocity(float dt, NearestNeighborsFinder* nearestNeighborsFinder)
+	void Agent::wake()
 	{
-		size_t maxResultLength = std::min(RVO_GET_NEAREST_AGENTS_MAX_BUFFER_SIZE, maxNeighbors);
-		NeighborEntity agentNeighbours[RVO_GET_NEAREST_AGENTS_MAX_BUFFER_SIZE];
-		
-		size_t neighboursCount = nearestNeighborsFinder->find(this, agentNeighbours, maxResultLength);
+		_sleeping = false;
+		_idleSteps = 0;
+	}
+
+	bool Agent::isSleeping() const
+	{
+		return _sleeping;
+	}
+
+	size_t Agent::getIndex() const
+	{
+		return _index;
+	}
 
+	void Agent::computeNewVelocity(float dt, const NeighborEntity* states, const uint32_t* neighbors, size_t neighboursCount)
+	{
 		Line orcaLines[MAX_ORCA_LINES];
 		size_t orcaLinesCount = 0;
 
@@ -24,7 +36,7 @@ namespace RVO
 
 		/* Create agent ORCA lines. */
 		for (size_t i = 0; i < neighboursCount; ++i) {
-			NeighborEntity& other = agentNeighbours[i];
+			const NeighborEntity& other = states[neighbors[i]];
 
 			const vec2 relativePosition = other.position - position;
 			const vec2 relativeVelocity = velocity_ - other.velocity;
@@ -97,6 +109,15 @@ namespace RVO
 	}
 
 
+	void Agent::computeSteeringVelocity()
+	{
+		if (length2(prefVelocity) > sqr(maxSpeed))
+			newVelocity_ = normalize(prefVelocity) * maxSpeed;
+		else
+			newVelocity_ = prefVelocity;
+	}
+
+
 	void Agent::update(float dt)
 	{
 		velocity_ = newVelocity_;
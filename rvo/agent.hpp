@@ -13,6 +13,7 @@ namespace RVO
 
 	class Simulator;
 	class KdTree;
+	class FlowField;
 
 	class Agent 
 	{
@@ -22,8 +23,17 @@ namespace RVO
 		Agent();
 		virtual ~Agent();
 
+		// sleeping agents skip neighbor queries and the solve until something moves nearby
+		void wake();
+		bool isSleeping() const;
+		// position in the simulator's arrays, changes when agents are reordered or removed
+		size_t getIndex() const;
+
 	private:
-		void computeNewVelocity(float dt, NearestNeighborsFinder* nearestNeighborsFinder);
+		// neighbors are indices into states array
+		void computeNewVelocity(float dt, const NeighborEntity* states, const uint32_t* neighbors, size_t neighborsCount);
+		// no avoidance, just preferred velocity clamped to max speed
+		void computeSteeringVelocity();
 		void update(float dt);
 
 	public:
@@ -36,11 +46,16 @@ namespace RVO
 		float maxSpeed;
 		bool immobilized;
 		uint32_t mask;
+		// when set, preferred velocity is taken from the field every step
+		FlowField* flowField;
 
 	protected:
 		vec2 velocity_;
 		vec2 newVelocity_;
 		size_t _index;
+		bool _sleeping;
+		// consecutive steps the agent has been idle with no moving neighbors
+		uint32_t _idleSteps;
 	};
 
 }
@@ -0,0 +1,360 @@
+#include <algorithm>
+#include <cfloat>
+#include <assert.h>
+#include "rvo/flow_field.hpp"
+
+#define FLOW_FIELD_DIAGONAL_COST 1.41421356f
+// slack for comparing costs summed along different paths
+#define FLOW_FIELD_COST_EPSILON 1e-3f
+
+namespace RVO
+{
+
+	FlowField::FlowField(const vec2& origin, float cellSize, size_t width, size_t height) :
+		_origin(origin), _cellSize(cellSize), _width(width), _height(height), _cellsPerUpdate(RVO_FLOW_FIELD_DEFAULT_CELLS_PER_UPDATE),
+		_costOffset(0.0f), _goal(0, 0), _goalCell(0), _ready(false)
+	{
+		assert(cellSize > 0.0f);
+		assert(width > 0 && height > 0);
+		size_t cellsCount = _width * _height;
+		_blocked.assign(cellsCount, 0);
+		_costs.assign(cellsCount, FLT_MAX);
+		_frontier.reserve(cellsCount);
+	}
+
+	FlowField::~FlowField() {}
+
+	void FlowField::setGoal(const vec2& goal)
+	{
+		_goal = goal;
+		size_t cell;
+		if (!getCell(goal, cell))
+		{
+			// goal is off the grid, agents steer straight to it; the costs stay aimed at the last goal cell
+			_ready = false;
+			return;
+		}
+		_ready = true;
+		if (cell == _goalCell && _costs[cell] != FLT_MAX)
+			return;
+
+		// cost of the new goal cell is a path between the goals, so every cost plus it is a path via the old goal
+		float costBetweenGoals = _costs[cell] == FLT_MAX ? FLT_MAX : _costs[cell] + _costOffset;
+		size_t previousGoalCell = _goalCell;
+		bool blockedGoal = _blocked[previousGoalCell] != 0;
+		_goalCell = cell;
+		// paths via the old goal don't exist if it was inside an obstacle or the new one can't be reached from it
+		if (costBetweenGoals == FLT_MAX || blockedGoal)
+		{
+			reset();
+			return;
+		}
+		_costOffset += costBetweenGoals;
+		_costs[cell] = -_costOffset;
+		pushFrontier(cell);
+		_viaGoalCells.push_back((uint32_t)previousGoalCell);
+	}
+
+	const vec2& FlowField::getGoal() const
+	{
+		return _goal;
+	}
+
+	void FlowField::setBlocked(const vec2& min, const vec2& max, bool blocked)
+	{
+		int minX = std::max(0, (int)floorf((min.x - _origin.x) / _cellSize));
+		int minY = std::max(0, (int)floorf((min.y - _origin.y) / _cellSize));
+		int maxX = std::min((int)_width - 1, (int)floorf((max.x - _origin.x) / _cellSize));
+		int maxY = std::min((int)_height - 1, (int)floorf((max.y - _origin.y) / _cellSize));
+		uint8_t value = blocked ? 1 : 0;
+		for (int y = minY; y <= maxY; ++y)
+		{
+			for (int x = minX; x <= maxX; ++x)
+			{
+				size_t cell = y * _width + x;
+				if (_blocked[cell] == value)
+					continue;
+				_blocked[cell] = value;
+				// the goal cell keeps its cost even inside an obstacle
+				if (blocked && cell != _goalCell)
+					_costs[cell] = FLT_MAX;
+
+				for (int dy = -1; dy <= 1; ++dy)
+				{
+					for (int dx = -1; dx <= 1; ++dx)
+					{
+						int nx = x + dx;
+						int ny = y + dy;
+						if (nx < 0 || ny < 0 || nx >= (int)_width || ny >= (int)_height)
+							continue;
+						size_t neighbor = ny * _width + nx;
+						// paths through a blocked cell or its corners are gone, the ones around a freed cell open up
+						if (blocked)
+							_unsupported.push_back((uint32_t)neighbor);
+						else if (_costs[neighbor] != FLT_MAX)
+							pushFrontier(neighbor);
+					}
+				}
+			}
+		}
+		if (blocked)
+		{
+			// the path between the goals may be cut as well
+			_unsupported.insert(_unsupported.end(), _viaGoalCells.begin(), _viaGoalCells.end());
+			invalidate();
+		}
+	}
+
+	void FlowField::setCellsPerUpdate(size_t cellsPerUpdate)
+	{
+		_cellsPerUpdate = std::max((size_t)1, cellsPerUpdate);
+	}
+
+	bool FlowField::update()
+	{
+		if (_costOffset > RVO_FLOW_FIELD_MAX_COST_OFFSET)
+			rebase();
+		// a goal moving every step keeps seeding cheaper cells, so entries left behind by earlier repairs pile up
+		if (_frontier.size() > _costs.size())
+			compactFrontier();
+		integrate(_cellsPerUpdate);
+		// old goals reached by the repair get their costs from the neighbors
+		for (size_t i = 0; i < _viaGoalCells.size(); )
+		{
+			if (_frontier.empty() || _costs[_viaGoalCells[i]] == FLT_MAX || isSupported(_viaGoalCells[i]))
+			{
+				_viaGoalCells[i] = _viaGoalCells.back();
+				_viaGoalCells.pop_back();
+			}
+			else
+				++i;
+		}
+		return _frontier.empty();
+	}
+
+	vec2 FlowField::getPreferredVelocity(const vec2& position, float speed) const
+	{
+		size_t cell;
+		if (!_ready || !getCell(position, cell) || cell == _goalCell || length2(_goal - position) < sqr(_cellSize))
+			return steerStraight(position, speed);
+
+		vec2 direction = getDirection(cell);
+		// blocked cell or the one not reached by the repair yet
+		if (direction.x == 0.0f && direction.y == 0.0f)
+			return steerStraight(position, speed);
+		return direction * speed;
+	}
+
+	bool FlowField::getCell(const vec2& position, size_t& cell) const
+	{
+		float x = (position.x - _origin.x) / _cellSize;
+		float y = (position.y - _origin.y) / _cellSize;
+		if (x < 0.0f || y < 0.0f || x >= (float)_width || y >= (float)_height)
+			return false;
+		cell = (size_t)y * _width + (size_t)x;
+		return true;
+	}
+
+	bool FlowField::isPassable(int x, int y, int dx, int dy) const
+	{
+		size_t from = y * _width + x;
+		// paths start from the goal cell even if it is blocked
+		if (_blocked[(y + dy) * _width + x + dx] || (_blocked[from] && from != _goalCell))
+			return false;
+		return dx == 0 || dy == 0 || (!_blocked[y * _width + x + dx] && !_blocked[(y + dy) * _width + x]);
+	}
+
+	bool FlowField::isSupported(size_t cell) const
+	{
+		float cost = _costs[cell];
+		int x = (int)(cell % _width);
+		int y = (int)(cell / _width);
+		for (int dy = -1; dy <= 1; ++dy)
+		{
+			for (int dx = -1; dx <= 1; ++dx)
+			{
+				int nx = x + dx;
+				int ny = y + dy;
+				if ((dx == 0 && dy == 0) || nx < 0 || ny < 0 || nx >= (int)_width || ny >= (int)_height)
+					continue;
+				size_t neighbor = ny * _width + nx;
+				float neighborCost = _costs[neighbor];
+				if (neighborCost == FLT_MAX || !isPassable(nx, ny, -dx, -dy))
+					continue;
+				float step = (dx != 0 && dy != 0) ? FLOW_FIELD_DIAGONAL_COST : 1.0f;
+				if (neighborCost + step <= cost + FLOW_FIELD_COST_EPSILON)
+					return true;
+			}
+		}
+		return false;
+	}
+
+	void FlowField::pushFrontier(size_t cell)
+	{
+		FrontierEntry entry = { _costs[cell], (uint32_t)cell };
+		_frontier.push_back(entry);
+		std::push_heap(_frontier.begin(), _frontier.end());
+	}
+
+	void FlowField::reset()
+	{
+		std::fill(_costs.begin(), _costs.end(), FLT_MAX);
+		_frontier.clear();
+		_costOffset = 0.0f;
+		_viaGoalCells.clear();
+		_costs[_goalCell] = 0.0f;
+		pushFrontier(_goalCell);
+	}
+
+	// drops costs left without a neighbor they could come from, the border of the dropped region is relaxed again
+	// a supporting neighbor is strictly cheaper, so the support can't go round in circles
+	void FlowField::invalidate()
+	{
+		_invalidated.clear();
+		while (!_unsupported.empty())
+		{
+			size_t cell = _unsupported.back();
+			_unsupported.pop_back();
+			if (cell == _goalCell || _costs[cell] == FLT_MAX)
+				continue;
+
+			if (isSupported(cell))
+				continue;
+
+			_costs[cell] = FLT_MAX;
+			_invalidated.push_back((uint32_t)cell);
+			int x = (int)(cell % _width);
+			int y = (int)(cell / _width);
+			for (int dy = -1; dy <= 1; ++dy)
+			{
+				for (int dx = -1; dx <= 1; ++dx)
+				{
+					int nx = x + dx;
+					int ny = y + dy;
+					if ((dx == 0 && dy == 0) || nx < 0 || ny < 0 || nx >= (int)_width || ny >= (int)_height)
+						continue;
+					_unsupported.push_back((uint32_t)(ny * _width + nx));
+				}
+			}
+		}
+
+		for (size_t i = 0; i < _invalidated.size(); ++i)
+		{
+			int x = (int)(_invalidated[i] % _width);
+			int y = (int)(_invalidated[i] / _width);
+			for (int dy = -1; dy <= 1; ++dy)
+			{
+				for (int dx = -1; dx <= 1; ++dx)
+				{
+					int nx = x + dx;
+					int ny = y + dy;
+					if ((dx == 0 && dy == 0) || nx < 0 || ny < 0 || nx >= (int)_width || ny >= (int)_height)
+						continue;
+					size_t neighbor = ny * _width + nx;
+					if (_costs[neighbor] != FLT_MAX)
+						pushFrontier(neighbor);
+				}
+			}
+		}
+	}
+
+	// adding the same value keeps the order of the frontier and its entries equal to the costs
+	void FlowField::rebase()
+	{
+		for (size_t i = 0; i < _costs.size(); ++i)
+			if (_costs[i] != FLT_MAX)
+				_costs[i] += _costOffset;
+		for (size_t i = 0; i < _frontier.size(); ++i)
+			_frontier[i].cost += _costOffset;
+		_costOffset = 0.0f;
+	}
+
+	// drops entries whose cells got cheaper or lost their costs since they were pushed
+	void FlowField::compactFrontier()
+	{
+		size_t kept = 0;
+		for (size_t i = 0; i < _frontier.size(); ++i)
+			if (_frontier[i].cost == _costs[_frontier[i].cell])
+				_frontier[kept++] = _frontier[i];
+		_frontier.resize(kept);
+		std::make_heap(_frontier.begin(), _frontier.end());
+	}
+
+	// dijkstra over 8-connected grid, seeded with the costs already known: only cells getting cheaper are visited
+	size_t FlowField::integrate(size_t budget)
+	{
+		size_t processed = 0;
+		while (!_frontier.empty() && processed < budget)
+		{
+			std::pop_heap(_frontier.begin(), _frontier.end());
+			FrontierEntry entry = _frontier.back();
+			_frontier.pop_back();
+			// the cost was lowered since, or dropped by invalidation
+			if (entry.cost != _costs[entry.cell])
+				continue;
+			++processed;
+
+			int x = (int)(entry.cell % _width);
+			int y = (int)(entry.cell / _width);
+			for (int dy = -1; dy <= 1; ++dy)
+			{
+				for (int dx = -1; dx <= 1; ++dx)
+				{
+					int nx = x + dx;
+					int ny = y + dy;
+					if ((dx == 0 && dy == 0) || nx < 0 || ny < 0 || nx >= (int)_width || ny >= (int)_height)
+						continue;
+					size_t neighbor = ny * _width + nx;
+					if (!isPassable(x, y, dx, dy))
+						continue;
+					float cost = entry.cost + ((dx != 0 && dy != 0) ? FLOW_FIELD_DIAGONAL_COST : 1.0f);
+					if (cost < _costs[neighbor])
+					{
+						_costs[neighbor] = cost;
+						pushFrontier(neighbor);
+					}
+				}
+			}
+		}
+		return processed;
+	}
+
+	vec2 FlowField::getDirection(size_t cell) const
+	{
+		float cost = _costs[cell];
+		if (cost == FLT_MAX)
+			return vec2(0, 0);
+
+		int x = (int)(cell % _width);
+		int y = (int)(cell / _width);
+		vec2 gradient(0, 0);
+		for (int dy = -1; dy <= 1; ++dy)
+		{
+			for (int dx = -1; dx <= 1; ++dx)
+			{
+				int nx = x + dx;
+				int ny = y + dy;
+				if ((dx == 0 && dy == 0) || nx < 0 || ny < 0 || nx >= (int)_width || ny >= (int)_height)
+					continue;
+				float neighborCost = _costs[ny * _width + nx];
+				// walls and unreachable cells push agents away
+				float descent = neighborCost == FLT_MAX ? -1.0f : cost - neighborCost;
+				float weight = (dx != 0 && dy != 0) ? 1.0f / FLOW_FIELD_DIAGONAL_COST : 1.0f;
+				gradient += vec2((float)dx, (float)dy) * (descent * weight);
+			}
+		}
+
+		float gradientLength = length(gradient);
+		return gradientLength > EPSILON ? gradient / gradientLength : vec2(0, 0);
+	}
+
+	vec2 FlowField::steerStraight(const vec2& position, float speed) const
+	{
+		vec2 toGoal = _goal - position;
+		float distanceSq = length2(toGoal);
+		if (distanceSq > sqr(speed))
+			return toGoal * (speed / sqrtf(distanceSq));
+		return toGoal;
+	}
+
+}
@@ -0,0 +1,94 @@
+#ifndef __FBE_RVO_FLOW_FIELD_HPP__
+#define __FBE_RVO_FLOW_FIELD_HPP__
+
+#include <stdint.h>
+#include <vector>
+#include "rvo/math.hpp"
+
+#define RVO_FLOW_FIELD_DEFAULT_CELLS_PER_UPDATE (size_t)4096
+// costs are rebased when the offset added by goal moves grows past this, to keep float precision
+#define RVO_FLOW_FIELD_MAX_COST_OFFSET 1024.0f
+
+using namespace Inanity::Math;
+
+namespace RVO
+{
+
+	// grid navigation field shared by all agents heading to the same goal
+	// costs to the goal are repaired in place instead of being recomputed:
+	// - when the goal cell moves, every cost becomes the cost of the path via the old goal, which takes one offset
+	//   shared by the grid, and dijkstra seeded with these costs lowers only the cells closer to the new goal, nearest first
+	// - blocking cells invalidates the costs whose paths led through them, unblocking relaxes the cells around
+	// the repair is spread over updates, but every cost is always the length of a real path to the current goal,
+	// so agents follow a moved goal from the next step, their paths only get shorter while the repair goes on
+	class FlowField
+	{
+	public:
+		FlowField(const vec2& origin, float cellSize, size_t width, size_t height);
+		virtual ~FlowField();
+
+		void setGoal(const vec2& goal);
+		const vec2& getGoal() const;
+		void setBlocked(const vec2& min, const vec2& max, bool blocked);
+		void setCellsPerUpdate(size_t cellsPerUpdate);
+
+		// advances the repair, returns true if the field is up to date
+		bool update();
+		// O(1) lookup, falls back to straight steering near the goal and outside of the grid
+		vec2 getPreferredVelocity(const vec2& position, float speed) const;
+
+	private:
+		struct FrontierEntry
+		{
+			float cost;
+			uint32_t cell;
+
+			// inverted for min-heap on std::push_heap
+			bool operator<(const FrontierEntry& other) const
+			{
+				return cost > other.cost;
+			}
+		};
+
+		bool getCell(const vec2& position, size_t& cell) const;
+		// whether an agent can step from the cell to the neighboring one, diagonal moves can't cut blocked corners
+		bool isPassable(int x, int y, int dx, int dy) const;
+		// whether a neighbor has the cost the cell's cost could come from
+		bool isSupported(size_t cell) const;
+		void pushFrontier(size_t cell);
+		void reset();
+		void invalidate();
+		void rebase();
+		void compactFrontier();
+		size_t integrate(size_t budget);
+		// normalized negative gradient of the costs
+		vec2 getDirection(size_t cell) const;
+		vec2 steerStraight(const vec2& position, float speed) const;
+
+	private:
+		vec2 _origin;
+		float _cellSize;
+		size_t _width;
+		size_t _height;
+		size_t _cellsPerUpdate;
+
+		std::vector<uint8_t> _blocked;
+		// cost to the goal is _costs[cell] + _costOffset, FLT_MAX for unreachable cells
+		std::vector<float> _costs;
+		float _costOffset;
+		std::vector<FrontierEntry> _frontier;
+		// cells to check after blocking, and the ones which lost their costs
+		std::vector<uint32_t> _unsupported;
+		std::vector<uint32_t> _invalidated;
+		// old goals not reached by the repair yet, their costs come from the path to the next goal, not from the neighbors
+		std::vector<uint32_t> _viaGoalCells;
+
+		vec2 _goal;
+		size_t _goalCell;
+		// false while the goal is off the grid
+		bool _ready;
+	};
+
+}
+
+#endif
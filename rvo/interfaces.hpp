@@ -11,6 +11,8 @@ namespace RVO
 	
 	class Agent;
 
+	// compact copy of agent's state, refreshed at the beginning of each step
+	// simulator keeps them in one array indexed by agent index, so ORCA lines don't touch Agent objects at all
 	struct NeighborEntity
 	{
 		vec2 position;
@@ -18,10 +20,14 @@ namespace RVO
 		float radius;
 	};
 
-	class NearestNeighborsFinder
+	// spatial index the simulator takes neighbours from, the game's global one, so that a single index is built per step
+	// results are agent indices (Agent::getIndex) which address the simulator's per-agent arrays directly
+	class INeighborIndex
 	{
 	public:
-		virtual size_t find(Agent* agent, NeighborEntity* result, size_t maxResultLength) = 0;
+		virtual ~INeighborIndex() {}
+		// up to maxResultLength agents within distance of the agent matching its mask, the agent itself excluded
+		virtual size_t getNeighborAgents(const Agent* agent, float distance, uint32_t* result, size_t maxResultLength) const = 0;
 	};
 
 }
@@ -1,31 +1,36 @@
+#include <algorithm>
+#include <cfloat>
+#include <cassert>
 #include "rvo/simulator.hpp"
 #include "rvo/agent.hpp"
 #include "rvo/interfaces.hpp"
-#include "spatial/kd_tree.hpp"
-#include "spatial/tree_base.hpp"
-#include "memory/pool_allocator.hpp"
+#include "rvo/flow_field.hpp"
+#include "jobs/job_system.hpp"
+#include "profiler/scope_profiler.h"
 
 namespace RVO 
 {
 
-	// todo: kill hardcode
-	Simulator::Simulator(size_t maxAgentsCount) : defaultAgent_(NULL), _agentsCount(0), _maxAgentsCount(maxAgentsCount)
+	Simulator::Simulator(size_t initialAgentsCapacity) : defaultAgent_(NULL), _agentsCount(0), _agentsCapacity(0), _lodFocus(0, 0), _stepsCount(0), _sleepingAgentsCount(0),
+		_reorderPeriod(RVO_DEFAULT_REORDER_PERIOD), _neighborIndex(nullptr), _wakeRequests(nullptr), _jobs(nullptr), _stepDt(0.0f)
 	{
+		disableLod();
 		defaultAgent_ = new Agent();
-		_agents.reserve(_maxAgentsCount);
-		for (size_t i = 0; i < _maxAgentsCount; ++i)
-			_agents.push_back(nullptr);
+		reserveAgents(std::max((size_t)1, initialAgentsCapacity));
 	}
 
 	Simulator::~Simulator()
 	{
 		_agents.clear();
+		delete [] _wakeRequests;
+		delete defaultAgent_;
 	}
 
 	Agent* Simulator::addAgent(Agent* agent)
 	{
-		assert(_agentsCount < _maxAgentsCount);
-		agent->_index = _agentsCount ;
+		if (_agentsCount == _agentsCapacity)
+			reserveAgents(_agentsCapacity * 2);
+		agent->_index = _agentsCount;
 		_agents[_agentsCount++] = agent;
 		return agent;
 	}
@@ -40,6 +45,27 @@ namespace RVO
 		--_agentsCount;
 	}
 
+	void Simulator::removeAgents(Agent* const* agents, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			assert(agents[i]->_index < _agentsCount);
+			assert(agents[i] == _agents[agents[i]->_index]);
+			_agents[agents[i]->_index] = nullptr;
+		}
+
+		size_t kept = 0;
+		for (size_t i = 0; i < _agentsCount; ++i)
+		{
+			Agent* agent = _agents[i];
+			if (agent == nullptr)
+				continue;
+			agent->_index = kept;
+			_agents[kept++] = agent;
+		}
+		_agentsCount = kept;
+	}
+
 	void Simulator::applyDefaultsToAgent(Agent* agent)
 	{
 		agent->maxNeighbors = defaultAgent_->maxNeighbors;
@@ -50,20 +76,374 @@ namespace RVO
 		agent->velocity_ = defaultAgent_->velocity_;
 	}
 
-	void Simulator::doStep(float dt, NearestNeighborsFinder* nearestNeighborsFinder)
+	void Simulator::setLodFocus(const vec2& focus)
+	{
+		_lodFocus = focus;
+	}
+
+	void Simulator::setLodLevel(size_t level, float minDistance, size_t updatePeriod, size_t maxNeighbors, bool steeringOnly)
+	{
+		assert(level > 0 && level < RVO_MAX_LOD_LEVELS);
+		if (level == 0 || level >= RVO_MAX_LOD_LEVELS)
+			return;
+		LodLevel& lod = _lodLevels[level];
+		lod.minDistanceSq = minDistance * minDistance;
+		lod.updatePeriod = std::max((size_t)1, updatePeriod);
+		lod.maxNeighbors = maxNeighbors;
+		lod.steeringOnly = steeringOnly;
+		_lodLevelsCount = std::max(_lodLevelsCount, level + 1);
+	}
+
+	void Simulator::disableLod()
+	{
+		LodLevel& full = _lodLevels[0];
+		full.minDistanceSq = 0.0f;
+		full.updatePeriod = 1;
+		full.maxNeighbors = RVO_GET_NEAREST_AGENTS_MAX_BUFFER_SIZE;
+		full.steeringOnly = false;
+		_lodLevelsCount = 1;
+	}
+
+	void Simulator::setReorderPeriod(size_t steps)
+	{
+		_reorderPeriod = steps;
+	}
+
+	void Simulator::setJobSystem(JobSystem* jobs)
+	{
+		_jobs = jobs;
+	}
+
+	void Simulator::setNeighborIndex(INeighborIndex* index)
+	{
+		_neighborIndex = index;
+	}
+
+	void Simulator::addFlowField(FlowField* field)
+	{
+		assert(std::find(_flowFields.begin(), _flowFields.end(), field) == _flowFields.end());
+		_flowFields.push_back(field);
+	}
+
+	void Simulator::removeFlowField(FlowField* field)
 	{
+		std::vector<FlowField*>::iterator it = std::find(_flowFields.begin(), _flowFields.end(), field);
+		if (it == _flowFields.end())
+			return;
+		*it = _flowFields.back();
+		_flowFields.pop_back();
+		for (size_t i = 0; i < _agentsCount; ++i)
+			if (_agents[i]->flowField == field)
+				_agents[i]->flowField = nullptr;
+	}
+
+	size_t Simulator::chooseLodLevel(const Agent* agent) const
+	{
+		float distanceSq = length2(agent->position - _lodFocus);
+		size_t level = 0;
+		while (level + 1 < _lodLevelsCount && distanceSq >= _lodLevels[level + 1].minDistanceSq)
+			++level;
+		return level;
+	}
+
+	// agents are referenced by pointer, so only simulator's own per-agent arrays are reallocated
+	void Simulator::reserveAgents(size_t count)
+	{
+		if (count <= _agentsCapacity)
+			return;
+		_agentsCapacity = count;
+		_agents.resize(count, nullptr);
+		_agentStates.resize(count);
+		_updateModes.resize(count);
+		_neighborOffsets.resize(count + 1);
+		_neighborCounts.resize(count);
+		// requests don't outlive a step, and agents are not added during one
+		delete [] _wakeRequests;
+		_wakeRequests = new std::atomic<bool>[count];
+		for (size_t i = 0; i < count; ++i)
+			_wakeRequests[i].store(false, std::memory_order_relaxed);
+	}
+
+	void Simulator::doStep(float dt)
+	{
+		SCOPE_PROFILER(RvoStep);
+		solveStep(dt);
+		applyNewVelocities(dt);
+	}
+
+	void Simulator::solveStep(float dt)
+	{
+		prepareStep();
+		queryNeighbors();
+		computeNewVelocities(dt);
+	}
+
+	void Simulator::forEachAgent(void (*function)(void* simulator, size_t begin, size_t end))
+	{
+		if (_jobs != nullptr)
+			_jobs->parallelFor(function, this, _agentsCount, RVO_AGENTS_PER_JOB);
+		else if (_agentsCount > 0)
+			function(this, 0, _agentsCount);
+	}
+
+	void Simulator::prepareStep()
+	{
+		SCOPE_PROFILER(RvoPrepare);
+		if (_reorderPeriod > 0 && _stepsCount % _reorderPeriod == 0)
+			reorderAgents();
+
+		for (size_t i = 0; i < _flowFields.size(); ++i)
+			_flowFields[i]->update();
+
+		size_t neighborsCapacity = 0;
+		_sleepingAgentsCount = 0;
 		for (size_t i = 0; i < _agentsCount; ++i)
 		{
-			if (!_agents[i]->immobilized)
-				_agents[i]->computeNewVelocity(dt, nearestNeighborsFinder);
+			Agent* agent = _agents[i];
+			NeighborEntity& state = _agentStates[i];
+			state.position = agent->position;
+			state.velocity = agent->velocity_;
+			state.radius = agent->radius;
+
+			_neighborOffsets[i] = neighborsCapacity;
+			_neighborCounts[i] = 0;
+
+			if (agent->immobilized)
+			{
+				_updateModes[i] = updateStop;
+				continue;
+			}
+
+			if (agent->flowField != nullptr)
+				agent->prefVelocity = agent->flowField->getPreferredVelocity(agent->position, agent->maxSpeed);
+
+			if (agent->_sleeping)
+			{
+				// preferred velocity changed by scripts or by the flow field
+				if (length2(agent->prefVelocity) > sqr(RVO_SLEEP_SPEED))
+				{
+					agent->wake();
+				}
+				else
+				{
+					_updateModes[i] = updateSleep;
+					++_sleepingAgentsCount;
+					continue;
+				}
+			}
+
+			// level is re-evaluated every step, so agents coming near are promoted back to the full solve at once
+			const LodLevel& lod = _lodLevels[chooseLodLevel(agent)];
+			if ((_stepsCount + i) % lod.updatePeriod != 0)
+			{
+				_updateModes[i] = updateSkip;
+			}
+			else if (lod.steeringOnly)
+			{
+				_updateModes[i] = updateSteering;
+			}
 			else
-				_agents[i]->newVelocity_ = vec2(0, 0);
+			{
+				_updateModes[i] = updateFull;
+				neighborsCapacity += std::min(RVO_GET_NEAREST_AGENTS_MAX_BUFFER_SIZE, std::min(agent->maxNeighbors, lod.maxNeighbors));
+			}
 		}
-			
+		_neighborOffsets[_agentsCount] = neighborsCapacity;
+		if (_neighbors.size() < neighborsCapacity)
+			_neighbors.resize(neighborsCapacity);
+	}
+
+	void Simulator::queryNeighbors()
+	{
+		forEachAgent([](void* simulator, size_t begin, size_t end) { static_cast<Simulator*>(simulator)->queryNeighbors(begin, end); });
+	}
+
+	void Simulator::queryNeighbors(size_t begin, size_t end)
+	{
+		SCOPE_PROFILER(RvoQueryNeighbors);
+		if (_neighborIndex == nullptr)
+			return;
+		for (size_t i = begin; i < end; ++i)
+		{
+			if (_updateModes[i] != updateFull)
+				continue;
+
+			// the index writes indices straight into the agent's range of the neighbors array
+			Agent* agent = _agents[i];
+			uint32_t* neighbors = _neighbors.data() + _neighborOffsets[i];
+			size_t maxResultLength = _neighborOffsets[i + 1] - _neighborOffsets[i];
+			_neighborCounts[i] = (uint32_t)_neighborIndex->getNeighborAgents(agent, agent->neighborDist, neighbors, maxResultLength);
+		}
+	}
+
+	void Simulator::computeNewVelocities(float dt)
+	{
+		_stepDt = dt;
+		forEachAgent([](void* simulator, size_t begin, size_t end) { static_cast<Simulator*>(simulator)->computeNewVelocities(begin, end); });
+	}
+
+	void Simulator::computeNewVelocities(size_t begin, size_t end)
+	{
+		SCOPE_PROFILER(RvoComputeVelocities);
+		const float dt = _stepDt;
+		const NeighborEntity* states = _agentStates.empty() ? nullptr : &_agentStates[0];
+		const uint32_t* neighbors = _neighbors.empty() ? nullptr : &_neighbors[0];
+		for (size_t i = begin; i < end; ++i)
+		{
+			Agent* agent = _agents[i];
+			switch (_updateModes[i])
+			{
+			case updateStop:
+				agent->newVelocity_ = vec2(0, 0);
+				break;
+			case updateSteering:
+				agent->computeSteeringVelocity();
+				break;
+			case updateFull:
+				agent->computeNewVelocity(dt, states, neighbors + _neighborOffsets[i], _neighborCounts[i]);
+				updateSleeping(i);
+				break;
+			case updateSleep:
+				agent->newVelocity_ = vec2(0, 0);
+				break;
+			default:
+				// time-sliced agent keeps its previous velocity
+				break;
+			}
+			raiseWakeRequests(i, dt);
+		}
+	}
+
+	// agent which moves this step wakes sleepers around, whatever mode it's updated in, they join the solve on the next step
+	// sleepers may be in other chunks, so they are only marked here and woken when velocities are applied
+	void Simulator::raiseWakeRequests(size_t index, float dt)
+	{
+		uint8_t mode = _updateModes[index];
+		if (mode == updateStop || mode == updateSleep || _neighborIndex == nullptr)
+			return;
+		Agent* agent = _agents[index];
+		float speedSq = length2(agent->newVelocity_);
+		if (speedSq <= sqr(RVO_SLEEP_SPEED))
+			return;
+
+		const uint32_t* neighbors;
+		size_t count;
+		uint32_t found[RVO_WAKE_QUERY_MAX_NEIGHBORS];
+		if (mode == updateFull)
+		{
+			neighbors = _neighbors.data() + _neighborOffsets[index];
+			count = _neighborCounts[index];
+		}
+		else
+		{
+			// agents off the full solve have no neighbours of their own, only the space they pass this step is looked up
+			neighbors = found;
+			count = _neighborIndex->getNeighborAgents(agent, agent->radius + sqrtf(speedSq) * dt, found, RVO_WAKE_QUERY_MAX_NEIGHBORS);
+		}
+		for (size_t j = 0; j < count; ++j)
+			if (_updateModes[neighbors[j]] == updateSleep)
+				_wakeRequests[neighbors[j]].store(true, std::memory_order_relaxed);
+	}
+
+	namespace
+	{
+		// spreads lower 16 bits so that there is a zero bit between each two of them
+		inline uint32_t spreadBits(uint32_t value)
+		{
+			value &= 0xffff;
+			value = (value | (value << 8)) & 0x00ff00ff;
+			value = (value | (value << 4)) & 0x0f0f0f0f;
+			value = (value | (value << 2)) & 0x33333333;
+			value = (value | (value << 1)) & 0x55555555;
+			return value;
+		}
+	}
+
+	// agents are referenced by pointer from outside, so only their order in _agents and _index change
+	void Simulator::reorderAgents()
+	{
+		SCOPE_PROFILER(RvoReorder);
+		if (_agentsCount < 2)
+			return;
+
+		vec2 min(FLT_MAX, FLT_MAX);
+		vec2 max(-FLT_MAX, -FLT_MAX);
 		for (size_t i = 0; i < _agentsCount; ++i)
 		{
-			_agents[i]->update(dt);
-		}	
+			const vec2& position = _agents[i]->position;
+			min.x = std::min(min.x, position.x);
+			min.y = std::min(min.y, position.y);
+			max.x = std::max(max.x, position.x);
+			max.y = std::max(max.y, position.y);
+		}
+
+		// quantize positions to 16 bits per axis, key is the code in high half and agent index in low one
+		float scale = 65535.0f / std::max(EPSILON, std::max(max.x - min.x, max.y - min.y));
+		_reorderKeys.resize(_agentsCount);
+		for (size_t i = 0; i < _agentsCount; ++i)
+		{
+			const vec2& position = _agents[i]->position;
+			uint32_t x = (uint32_t)((position.x - min.x) * scale);
+			uint32_t y = (uint32_t)((position.y - min.y) * scale);
+			uint64_t code = spreadBits(x) | (spreadBits(y) << 1);
+			_reorderKeys[i] = (code << 32) | (uint64_t)i;
+		}
+		std::sort(_reorderKeys.begin(), _reorderKeys.end());
+
+		_reorderedAgents.resize(_agentsCount);
+		for (size_t i = 0; i < _agentsCount; ++i)
+		{
+			Agent* agent = _agents[(uint32_t)_reorderKeys[i]];
+			agent->_index = i;
+			_reorderedAgents[i] = agent;
+		}
+		std::copy(_reorderedAgents.begin(), _reorderedAgents.end(), _agents.begin());
+	}
+
+	// idle neighbors don't keep the agent awake, otherwise a settled crowd would never fall asleep
+	void Simulator::updateSleeping(size_t index)
+	{
+		Agent* agent = _agents[index];
+		const float sleepSpeedSq = sqr(RVO_SLEEP_SPEED);
+		bool idle = length2(agent->newVelocity_) <= sleepSpeedSq && length2(agent->prefVelocity) <= sleepSpeedSq;
+		const uint32_t* neighbors = _neighbors.data() + _neighborOffsets[index];
+		for (size_t j = 0; idle && j < _neighborCounts[index]; ++j)
+			idle = length2(_agentStates[neighbors[j]].velocity) <= sleepSpeedSq;
+
+		if (!idle)
+		{
+			agent->_idleSteps = 0;
+			return;
+		}
+
+		if (++agent->_idleSteps >= RVO_SLEEP_STEPS)
+		{
+			agent->_sleeping = true;
+			agent->newVelocity_ = vec2(0, 0);
+		}
+	}
+
+	void Simulator::applyNewVelocities(float dt)
+	{
+		_stepDt = dt;
+		forEachAgent([](void* simulator, size_t begin, size_t end) { static_cast<Simulator*>(simulator)->applyNewVelocities(begin, end); });
+		++_stepsCount;
+	}
+
+	void Simulator::applyNewVelocities(size_t begin, size_t end)
+	{
+		SCOPE_PROFILER(RvoApplyVelocities);
+		const float dt = _stepDt;
+		for (size_t i = begin; i < end; ++i)
+		{
+			Agent* agent = _agents[i];
+			if (_wakeRequests[i].load(std::memory_order_relaxed))
+			{
+				_wakeRequests[i].store(false, std::memory_order_relaxed);
+				agent->wake();
+			}
+			agent->update(dt);
+		}
 	}
 
 	size_t Simulator::getNumAgents() const
@@ -73,7 +453,12 @@ namespace RVO
 
 	size_t Simulator::getMaxAgents() const
 	{
-		return _maxAgentsCount;
+		return _agentsCapacity;
+	}
+
+	size_t Simulator::getNumSleepingAgents() const
+	{
+		return _sleepingAgentsCount;
 	}
 
 	void Simulator::setAgentDefaults(float neighborDist, size_t maxNeighbors, float timeHorizon, float radius, float maxSpeed, const vec2 &velocity)
@@ -2,41 +2,146 @@
 #define __FBE_RVO_SIMULATOR_H__
 
 #include <vector>
+#include <atomic>
 #include "rvo/math.hpp"
+#include "rvo/interfaces.hpp"
 #include "spatial/interfaces.hpp"
 
+#define RVO_MAX_LOD_LEVELS (size_t)4
+// agent falls asleep after being slower than this for RVO_SLEEP_STEPS steps in a row
+#define RVO_SLEEP_SPEED 0.05f
+#define RVO_SLEEP_STEPS 8
+// sleepers looked up around a moving agent which has no neighbours of the full solve
+#define RVO_WAKE_QUERY_MAX_NEIGHBORS (size_t)16
+#define RVO_DEFAULT_REORDER_PERIOD 32
+// per-agent phases are split between job system threads by chunks of at least this many agents
+#define RVO_AGENTS_PER_JOB 64
+
 using namespace Inanity::Math;
 
-class PoolAllocator;
+class JobSystem;
 
 namespace RVO 
 {
 
 	class Agent;
-	class NearestNeighborsFinder;
+	class FlowField;
+
+	// level of detail for agents far from the focus point (camera, player)
+	// level 0 is the full ORCA solve every step, farther levels are updated time-sliced, 
+	// with fewer neighbors or by plain steering towards preferred velocity
+	struct LodLevel
+	{
+		// squared distance to the focus point from which the level is used
+		float minDistanceSq;
+		// agent gets a new velocity once per updatePeriod steps, round-robin by agent index
+		size_t updatePeriod;
+		size_t maxNeighbors;
+		bool steeringOnly;
+	};
 
 	class Simulator 
 	{
 		friend class Agent;
 
 	public:
-		Simulator(size_t maxAgentsCount);
+		// initial capacity, arrays grow when more agents are added
+		Simulator(size_t initialAgentsCapacity);
 		virtual ~Simulator();
 
 		Agent* addAgent(Agent* agent);
 		void removeAgent(Agent* agent);
+		// single pass over agents, keeps the order of the rest
+		void removeAgents(Agent* const* agents, size_t count);
 		size_t getNumAgents() const;
+		// agents which fit without reallocating per-step data
 		size_t getMaxAgents() const;
+		size_t getNumSleepingAgents() const;
 		void applyDefaultsToAgent(Agent* agent);
 		void setAgentDefaults(float neighborDist, size_t maxNeighbors, float timeHorizon, float radius, float maxSpeed, const vec2& velocity = vec2());
 
-		void doStep(float dt, NearestNeighborsFinder* nearestNeighborsFinder);
+		void setLodFocus(const vec2& focus);
+		// levels should be configured in order of increasing distance, level 0 is always the full solve
+		void setLodLevel(size_t level, float minDistance, size_t updatePeriod, size_t maxNeighbors, bool steeringOnly);
+		void disableLod();
+
+		// registered fields are advanced once per step, before agents bound to them sample preferred velocities
+		void addFlowField(FlowField* field);
+		void removeFlowField(FlowField* field);
+
+		// agents are sorted along a Morton curve once per period steps, so that neighbors are close in memory
+		// 0 disables reordering
+		void setReorderPeriod(size_t steps);
+		// per-agent phases run on the job system's threads, nullptr (default) runs them on the calling one
+		void setJobSystem(JobSystem* jobs);
+		// neighbours are taken from the index, which must hold the agents' positions of the step being solved
+		// without an index agents don't avoid each other
+		void setNeighborIndex(INeighborIndex* index);
+
+		void doStep(float dt);
+		// doStep is solveStep followed by applyNewVelocities, agents' positions are not changed by the former,
+		// so other jobs may read them meanwhile
+		void solveStep(float dt);
+
+		// doStep runs these in order, they are public so that tools can time them separately
+		// samples flow fields, chooses who is updated this step and snapshots agents' state
+		void prepareStep();
+		void queryNeighbors();
+		void computeNewVelocities(float dt);
+		void applyNewVelocities(float dt);
+
+	private:
+		enum UpdateMode
+		{
+			updateSkip,
+			updateSleep,
+			updateStop,
+			updateSteering,
+			updateFull
+		};
+
+		size_t chooseLodLevel(const Agent* agent) const;
+		void reserveAgents(size_t count);
+		void updateSleeping(size_t index);
+		void raiseWakeRequests(size_t index, float dt);
+		void reorderAgents();
+		// runs function for all agents, split into chunks when there is a job system
+		void forEachAgent(void (*function)(void* simulator, size_t begin, size_t end));
+		void queryNeighbors(size_t begin, size_t end);
+		void computeNewVelocities(size_t begin, size_t end);
+		void applyNewVelocities(size_t begin, size_t end);
 
 	protected:
 		std::vector<Agent*> _agents;
 		size_t _agentsCount;
-		size_t _maxAgentsCount;
+		size_t _agentsCapacity;
 		Agent* defaultAgent_;
+		std::vector<FlowField*> _flowFields;
+		LodLevel _lodLevels[RVO_MAX_LOD_LEVELS];
+		size_t _lodLevelsCount;
+		vec2 _lodFocus;
+		size_t _stepsCount;
+		size_t _sleepingAgentsCount;
+		size_t _reorderPeriod;
+		// morton code and agent index pairs, kept between reorders to avoid reallocations
+		std::vector<uint64_t> _reorderKeys;
+		std::vector<Agent*> _reorderedAgents;
+
+		// per-step data, indexed the same way as _agents
+		std::vector<NeighborEntity> _agentStates;
+		std::vector<uint8_t> _updateModes;
+		// neighbors of agent i are _neighbors[_neighborOffsets[i] .. _neighborOffsets[i] + _neighborCounts[i]),
+		// stored as indices into _agentStates
+		std::vector<size_t> _neighborOffsets;
+		std::vector<uint32_t> _neighborCounts;
+		std::vector<uint32_t> _neighbors;
+		INeighborIndex* _neighborIndex;
+		// sleepers woken by moving neighbors, set from any thread while velocities are computed and applied with them
+		std::atomic<bool>* _wakeRequests;
+
+		JobSystem* _jobs;
+		// time step of the step being computed, for the chunk functions
+		float _stepDt;
 	};
 }
 
@@ -8,15 +8,23 @@
 #include "script/camera.hpp"
 #include "script/input.hpp"
 #include "script/spatial.hpp"
+#include "script/profiler.hpp"
 #include "gamelogic/rvo.hpp"
 
 /* SPATIAL */
 META_CLASS(Firstblood::ScriptSpatialIndex, Firstblood.Space);
 	META_METHOD(raycast);
 	META_METHOD(getNeighbors);
+	META_METHOD(getQueryCounters);
 	META_METHOD(draw);
 META_CLASS_END();
 
+/* PROFILER */
+META_CLASS(Firstblood::ScriptProfiler, Firstblood.Profiler);
+	META_METHOD(begin);
+	META_METHOD(end);
+META_CLASS_END();
+
 /* INPUT */
 META_CLASS(Firstblood::ScriptInput, Firstblood.Input)
 	META_METHOD(addListener);
@@ -42,11 +50,15 @@ META_CLASS(Firstblood::RvoSimulation, Firstblood.RvoSimulation);
 	META_METHOD(setAgentDefaults);
 	META_METHOD(getNumAgents);
 	META_METHOD(getMaxAgents);
+	META_METHOD(setLodFocus);
+	META_METHOD(setLodLevel);
 	META_METHOD(create);
 	META_METHOD(destroy);
-META_CLASS_END();
-
-META_CLASS(Firstblood::RvoAgent, Firstblood.RvoAgent);
+	META_METHOD(isAlive);
+	META_METHOD(createFlowField);
+	META_METHOD(destroyFlowField);
+	META_METHOD(getPosition);
+	META_METHOD(getRadius);
 	META_METHOD(getMask);
 	META_METHOD(setMask);
 	META_METHOD(setMaxNeighbors);
@@ -55,8 +67,12 @@ META_CLASS(Firstblood::RvoAgent, Firstblood.RvoAgent);
 	META_METHOD(getMaxSpeed);
 	META_METHOD(setMaxSpeed);
 	META_METHOD(setPrefVelocity);
-	META_METHOD(getPosition);
-	META_METHOD(getRadius);
+	META_METHOD(setFlowField);
+META_CLASS_END();
+
+META_CLASS(Firstblood::RvoFlowField, Firstblood.RvoFlowField);
+	META_METHOD(setGoal);
+	META_METHOD(setBlocked);
 META_CLASS_END();
 
 /* UTILITIES */
@@ -69,6 +85,7 @@ META_CLASS(Firstblood::ScriptSystem, Firstblood.Engine);
 	META_METHOD(getCamera);
 	META_METHOD(getInput);
 	META_METHOD(getSpatialIndex);
+	META_METHOD(getProfiler);
 	META_METHOD(require);
 META_CLASS_END();
 
@@ -0,0 +1,146 @@
+#include "inanity/platform/FileSystem.hpp"
+#include "inanity/MemoryFile.hpp"
+#include "inanity/Exception.hpp"
+#include "inanity/script/v8/Function.hpp"
+#include "inanity/script/v8/v8.hpp"
+#include "script/code_cache.hpp"
+#include <cstdlib>
+#include <cstring>
+
+#define SCRIPT_CODE_CACHE_MAGIC 0x43534246 // FBSC
+#define SCRIPT_CODE_CACHE_FNV_BASIS 14695981039346656037ULL
+#define SCRIPT_CODE_CACHE_FNV_PRIME 1099511628211ULL
+
+namespace Firstblood
+{
+
+	ScriptCodeCache::ScriptCodeCache(Mode mode) : _mode(mode), _hitsCount(0), _missesCount(0) {}
+
+	ScriptCodeCache::Mode ScriptCodeCache::getModeFromEnvironment()
+	{
+		const char* variable = getenv("FIRSTBLOOD_SCRIPT_CACHE");
+		if (!variable || !*variable)
+			return modeUse;
+		if (strcmp(variable, "off") == 0)
+			return modeOff;
+		if (strcmp(variable, "build") == 0)
+			return modeBuild;
+		THROW("FIRSTBLOOD_SCRIPT_CACHE should be off or build");
+	}
+
+	ptr<Inanity::Script::Function> ScriptCodeCache::load(Inanity::Script::V8::State* state, const Inanity::String& fileName, ptr<Inanity::File> source)
+	{
+		if (_mode == modeOff)
+		{
+			++_missesCount;
+			return state->LoadScript(source);
+		}
+
+		uint64_t sourceHash = hash(source->GetData(), source->GetSize(), SCRIPT_CODE_CACHE_FNV_BASIS);
+		if (_mode == modeBuild)
+		{
+			++_missesCount;
+			return produce(state, fileName, source, sourceHash);
+		}
+
+		ptr<Inanity::Script::Function> script = tryConsume(state, fileName, source, sourceHash);
+		if (script)
+		{
+			++_hitsCount;
+			return script;
+		}
+		++_missesCount;
+		return state->LoadScript(source);
+	}
+
+	size_t ScriptCodeCache::getHitsCount() const
+	{
+		return _hitsCount;
+	}
+
+	size_t ScriptCodeCache::getMissesCount() const
+	{
+		return _missesCount;
+	}
+
+	uint64_t ScriptCodeCache::hash(const void* data, size_t size, uint64_t seed)
+	{
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		uint64_t result = seed;
+		for (size_t i = 0; i < size; ++i)
+		{
+			result ^= bytes[i];
+			result *= SCRIPT_CODE_CACHE_FNV_PRIME;
+		}
+		return result;
+	}
+
+	uint64_t ScriptCodeCache::getVersionHash()
+	{
+		// V8 checks its version and flags in the cached data too, but a mismatch there costs a wasted read
+		const char* version = v8::V8::GetVersion();
+		return hash(version, strlen(version), SCRIPT_CODE_CACHE_FNV_BASIS);
+	}
+
+	ptr<Inanity::Script::Function> ScriptCodeCache::tryConsume(Inanity::Script::V8::State* state, const Inanity::String& fileName, ptr<Inanity::File> source, uint64_t sourceHash)
+	{
+		ptr<Inanity::File> cacheFile = Inanity::Platform::FileSystem::GetNativeFileSystem()->TryLoadFile(fileName + SCRIPT_CODE_CACHE_EXTENSION);
+		if (!cacheFile || cacheFile->GetSize() < sizeof(Header))
+			return nullptr;
+		Header header;
+		memcpy(&header, cacheFile->GetData(), sizeof(header));
+		if (header.magic != SCRIPT_CODE_CACHE_MAGIC || header.sourceHash != sourceHash || header.versionHash != getVersionHash()
+			|| header.dataSize != cacheFile->GetSize() - sizeof(Header))
+			return nullptr;
+
+		v8::Isolate* isolate = state->GetIsolate();
+		v8::Isolate::Scope isolateScope(isolate);
+		v8::HandleScope handleScope(isolate);
+		v8::Context::Scope contextScope(state->GetContext());
+		v8::TryCatch tryCatch(isolate);
+
+		// the data stays owned by the file, which outlives the compilation
+		v8::ScriptCompiler::Source compilerSource(
+			v8::String::NewFromUtf8(isolate, (const char*)source->GetData(), v8::String::kNormalString, (int)source->GetSize()),
+			v8::ScriptOrigin(v8::String::NewFromUtf8(isolate, fileName.c_str())),
+			new v8::ScriptCompiler::CachedData((const uint8_t*)cacheFile->GetData() + sizeof(Header), (int)header.dataSize));
+		v8::Local<v8::Script> script = v8::ScriptCompiler::Compile(isolate, &compilerSource, v8::ScriptCompiler::kConsumeCodeCache);
+		// errors are reported by the compilation from the source
+		if (script.IsEmpty() || compilerSource.GetCachedData()->rejected)
+			return nullptr;
+		return NEW(Inanity::Script::V8::Function(state, script));
+	}
+
+	ptr<Inanity::Script::Function> ScriptCodeCache::produce(Inanity::Script::V8::State* state, const Inanity::String& fileName, ptr<Inanity::File> source, uint64_t sourceHash)
+	{
+		v8::Isolate* isolate = state->GetIsolate();
+		v8::Isolate::Scope isolateScope(isolate);
+		v8::HandleScope handleScope(isolate);
+		v8::Context::Scope contextScope(state->GetContext());
+		v8::TryCatch tryCatch(isolate);
+
+		v8::ScriptCompiler::Source compilerSource(
+			v8::String::NewFromUtf8(isolate, (const char*)source->GetData(), v8::String::kNormalString, (int)source->GetSize()),
+			v8::ScriptOrigin(v8::String::NewFromUtf8(isolate, fileName.c_str())));
+		v8::Local<v8::Script> script = v8::ScriptCompiler::Compile(isolate, &compilerSource, v8::ScriptCompiler::kProduceCodeCache);
+		// let the state throw its usual exception for the broken script
+		if (script.IsEmpty())
+			return state->LoadScript(source);
+		const v8::ScriptCompiler::CachedData* cachedData = compilerSource.GetCachedData();
+		if (!cachedData || cachedData->length <= 0)
+			THROW("Can't produce code cache for " + fileName);
+
+		Header header;
+		header.magic = SCRIPT_CODE_CACHE_MAGIC;
+		header.dataSize = (uint32_t)cachedData->length;
+		header.sourceHash = sourceHash;
+		header.versionHash = getVersionHash();
+		ptr<Inanity::File> cacheFile = NEW(Inanity::MemoryFile(sizeof(Header) + header.dataSize));
+		memcpy(cacheFile->GetData(), &header, sizeof(header));
+		memcpy((char*)cacheFile->GetData() + sizeof(Header), cachedData->data, header.dataSize);
+		Inanity::Platform::FileSystem::GetNativeFileSystem()->SaveFile(cacheFile, fileName + SCRIPT_CODE_CACHE_EXTENSION);
+
+		return NEW(Inanity::Script::V8::Function(state, script));
+	}
+
+}
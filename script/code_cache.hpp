@@ -0,0 +1,72 @@
+#ifndef __FB_SCRIPT_CODE_CACHE_HPP__
+#define __FB_SCRIPT_CODE_CACHE_HPP__
+
+#include <cstdint>
+#include "inanity/ptr.hpp"
+#include "inanity/String.hpp"
+#include "inanity/File.hpp"
+#include "inanity/script/Function.hpp"
+#include "inanity/script/v8/State.hpp"
+
+// cache files are stored next to the scripts: res/scripts/stdlib.js.cache
+#define SCRIPT_CODE_CACHE_EXTENSION ".cache"
+
+namespace Firstblood
+{
+
+	// V8 code cache of script files, skipping parsing and compilation of the bundled sources at startup
+	// a cache file starts with a hash of the script source and of the V8 version, a file matching neither is ignored
+	// and the script is compiled from the source, as V8 does itself with cached data it rejects
+	// caches are built by running the game with FIRSTBLOOD_SCRIPT_CACHE=build, e.g. together with
+	// FIRSTBLOOD_HEADLESS=1 after the scripts change: every script loaded during the run gets a fresh cache
+	// FIRSTBLOOD_SCRIPT_CACHE=off compiles everything from the sources
+	class ScriptCodeCache
+	{
+	public:
+		enum Mode
+		{
+			modeOff,
+			modeUse,
+			modeBuild
+		};
+
+	public:
+		ScriptCodeCache(Mode mode);
+
+		// FIRSTBLOOD_SCRIPT_CACHE, modeUse if not set
+		static Mode getModeFromEnvironment();
+
+		// compiles the source, with the cache of the file if it matches
+		ptr<Inanity::Script::Function> load(Inanity::Script::V8::State* state, const Inanity::String& fileName, ptr<Inanity::File> source);
+
+		// scripts compiled with a matching cache
+		size_t getHitsCount() const;
+		// scripts compiled from the source, including the ones whose cache was built
+		size_t getMissesCount() const;
+
+	private:
+		struct Header
+		{
+			uint32_t magic;
+			uint32_t dataSize;
+			uint64_t sourceHash;
+			uint64_t versionHash;
+		};
+
+		// fnv-1a
+		static uint64_t hash(const void* data, size_t size, uint64_t seed);
+		static uint64_t getVersionHash();
+
+		// nullptr if there is no cache for the source or V8 rejects it
+		ptr<Inanity::Script::Function> tryConsume(Inanity::Script::V8::State* state, const Inanity::String& fileName, ptr<Inanity::File> source, uint64_t sourceHash);
+		ptr<Inanity::Script::Function> produce(Inanity::Script::V8::State* state, const Inanity::String& fileName, ptr<Inanity::File> source, uint64_t sourceHash);
+
+	private:
+		Mode _mode;
+		size_t _hitsCount;
+		size_t _missesCount;
+	};
+
+}
+
+#endif
@@ -1,9 +1,19 @@
 #include "script/input.hpp"
 #include "script/system.hpp"
+#include "script/profiler.hpp"
+
+#include <algorithm>
+
+#define SCRIPT_INPUT_RESERVED_KEYS 16
 
 namespace Firstblood
 {
 
+	ScriptInput::ScriptInput() : _state(nullptr)
+	{
+		_charsDown.reserve(SCRIPT_INPUT_RESERVED_KEYS);
+	}
+
 	void ScriptInput::fini()
 	{
 		for (size_t i = 0; i < _listeners.size(); ++i)
@@ -23,14 +33,19 @@ namespace Firstblood
 			}
 			else if (event.keyboard.type == Inanity::Input::Event::Keyboard::typeKeyDown)
 			{
-				if (_charsDown.find(event.keyboard.key) != _charsDown.end())
+				if (isKeyDown(event.keyboard.key))
 					return false;
 				else
-					_charsDown.insert(event.keyboard.key);
+					_charsDown.push_back(event.keyboard.key);
 			}
 			else
 			{
-				_charsDown.erase(event.keyboard.key);
+				std::vector<uint>::iterator key = std::find(_charsDown.begin(), _charsDown.end(), (uint)event.keyboard.key);
+				if (key != _charsDown.end())
+				{
+					*key = _charsDown.back();
+					_charsDown.pop_back();
+				}
 			}
 		}
 		else
@@ -83,9 +98,9 @@ namespace Firstblood
 		{
 			if (!_listeners[i].second)
 			{
+				SCRIPT_CALL_PROFILER(ScriptInputListener);
 				ptr<Inanity::Script::Any> partialResult = _listeners[i].first->ApplyWith(nullptr, &scriptEvent, 1);
 				result = result || partialResult->AsInt();
-
 			}
 		}
 		return result;
@@ -113,11 +128,14 @@ namespace Firstblood
 
 	bool ScriptInput::isKeyDown(uint keyCode)
 	{
-		return _charsDown.find(keyCode) != _charsDown.end();
+		return std::find(_charsDown.begin(), _charsDown.end(), keyCode) != _charsDown.end();
 	}
 
 	vec2 ScriptInput::getCursorPosition()
 	{
+		// there is no input state in headless mode
+		if (!_state)
+			return vec2(0, 0);
 		return vec2((float)_state->cursorX, (float)_state->cursorY);
 	}
 
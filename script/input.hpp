@@ -2,7 +2,6 @@
 #define __FB_SCRIPT_INPUT_HPP__
 
 #include <vector>
-#include <unordered_set>
 #include "inanity/ptr.hpp"
 #include "inanity/math/basic.hpp"
 #include "inanity/meta/decl.hpp"
@@ -18,6 +17,7 @@ namespace Firstblood
 	class ScriptInput : public Inanity::Object
 	{
 	public:
+		ScriptInput();
 		void fini();
 		
 		bool handleEvent(const Inanity::Input::Event& event);
@@ -33,7 +33,8 @@ namespace Firstblood
 		// second element of the pair is "dead" mark
 		std::vector<std::pair<Inanity::Script::Any*, bool>> _listeners;
 		const Inanity::Input::State* _state;
-		std::unordered_set<uint> _charsDown;
+		// a few keys are down at once, a reserved vector doesn't allocate per key press as a set would
+		std::vector<uint> _charsDown;
 
 	META_DECLARE_CLASS(ScriptInput);
 	};
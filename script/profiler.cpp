@@ -0,0 +1,57 @@
+#include "script/profiler.hpp"
+
+namespace Firstblood
+{
+
+	std::vector<bool> ScriptProfiler::_openZones;
+
+	void ScriptProfiler::begin(const Inanity::String& name)
+	{
+		// runaway scripts which never call end are cut here
+		if (_openZones.size() >= SCRIPT_PROFILER_MAX_DEPTH)
+			return;
+		_openZones.push_back(ScopeProfiler::beginZone(getZone(name)));
+	}
+
+	void ScriptProfiler::end()
+	{
+		// unmatched ends are ignored
+		if (_openZones.empty())
+			return;
+		if (_openZones.back())
+			ScopeProfiler::endZone();
+		_openZones.pop_back();
+	}
+
+	size_t ScriptProfiler::getDepth()
+	{
+		return _openZones.size();
+	}
+
+	void ScriptProfiler::unwind(size_t depth)
+	{
+		while (_openZones.size() > depth)
+		{
+			if (_openZones.back())
+				ScopeProfiler::endZone();
+			_openZones.pop_back();
+		}
+	}
+
+	// zones live as long as the process, recorded events keep pointers to them
+	const ProfilerZone* ScriptProfiler::getZone(const Inanity::String& name)
+	{
+		static std::unordered_map<Inanity::String, ProfilerZone*> zones;
+		std::unordered_map<Inanity::String, ProfilerZone*>::iterator i = zones.find(name);
+		if (i != zones.end())
+			return i->second;
+
+		i = zones.insert(std::make_pair(name, new ProfilerZone())).first;
+		// keys of a node based map don't move
+		i->second->name = i->first.c_str();
+		i->second->fileName = "script";
+		i->second->lineNumber = 0;
+		return i->second;
+	}
+
+}
@@ -0,0 +1,56 @@
+#ifndef __FB_SCRIPT_PROFILER_HPP__
+#define __FB_SCRIPT_PROFILER_HPP__
+
+#include <vector>
+#include <unordered_map>
+#include "inanity/ptr.hpp"
+#include "inanity/String.hpp"
+#include "inanity/meta/decl.hpp"
+#include "profiler/scope_profiler.h"
+
+#define SCRIPT_PROFILER_MAX_DEPTH 32
+
+// profiler zone around a call into scripts, zones the script has left open are closed before it ends
+#define SCRIPT_CALL_PROFILER( NAME ) \
+	SCOPE_PROFILER( NAME ) \
+	Firstblood::ScriptProfilerUnwind SCOPE_PROFILER_CONCAT( scriptProfilerUnwind, __LINE__ );
+
+namespace Firstblood
+{
+
+	// Engine.Profiler: lets scripts open and close named profiler zones
+	// zone names are interned, so a name costs an allocation only the first time it is used
+	class ScriptProfiler : public Inanity::Object
+	{
+	public:
+		void begin(const Inanity::String& name);
+		void end();
+
+		// scripts run on one thread, so the open zones are tracked globally
+		static size_t getDepth();
+		static void unwind(size_t depth);
+
+	private:
+		static const ProfilerZone* getZone(const Inanity::String& name);
+
+	private:
+		// false for zones the profiler has dropped, they must not be closed
+		static std::vector<bool> _openZones;
+
+	META_DECLARE_CLASS(ScriptProfiler);
+	};
+
+
+	class ScriptProfilerUnwind
+	{
+	public:
+		ScriptProfilerUnwind() : _depth(ScriptProfiler::getDepth()) {}
+		~ScriptProfilerUnwind() { ScriptProfiler::unwind(_depth); }
+
+	private:
+		size_t _depth;
+	};
+
+}
+
+#endif
@@ -1,5 +1,6 @@
 #include "script/spatial.hpp"
 #include "script/system.hpp"
+#include "spatial/query_counters.hpp"
 
 #define MAX_SCRIPT_NEAREST_NEIGHBORS 64
 
@@ -47,6 +48,16 @@ namespace Firstblood
 		return result;
 	}
 
+	ptr<Inanity::Script::Any> ScriptSpatialIndex::getQueryCounters()
+	{
+		const Spatial::QueryCounters& counters = Spatial::getFrameQueryCounters();
+		ScriptSystem* system = ScriptSystem::getInstance();
+		ptr<Inanity::Script::Any> result = system->createScriptArray(Spatial::QUERY_COUNTERS_COUNT);
+		for (size_t i = 0; i < Spatial::QUERY_COUNTERS_COUNT; ++i)
+			result->Set((int)i, system->createScriptFloat((float)counters.values[i]));
+		return result;
+	}
+
 	void ScriptSpatialIndex::draw(float visualScale)
 	{
 		_index->draw(*this);
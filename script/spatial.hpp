@@ -23,6 +23,8 @@ namespace Firstblood
 
 		ptr<Inanity::Script::Any> raycast(const vec3& origin, const vec3& end, uint32_t mask);
 		ptr<Inanity::Script::Any> getNeighbors(const vec3& point, float distance, uint32_t mask, int maxResultLength);
+		// counters of the last frame in Spatial::QueryCounter order, zeroes unless built with SPATIAL_QUERY_COUNTERS
+		ptr<Inanity::Script::Any> getQueryCounters();
 		void draw(float visualScale);
 
 		// Spatial::IDrawer implementation
@@ -12,11 +12,13 @@ namespace Firstblood
 
 	ptr<ScriptSystem> ScriptSystem::getInstance() { return _instance; }
 
-	ScriptSystem::ScriptSystem(Painter* painter, ptr<RvoSimulation> rvoSimulation, mat4x4* cameraViewMatrix, Spatial::IIndex2D<ISpatiallyIndexable>* spatialIndex)
+	ScriptSystem::ScriptSystem(Painter* painter, ptr<RvoSimulation> rvoSimulation, mat4x4* cameraViewMatrix, Spatial::IIndex2D<ISpatiallyIndexable>* spatialIndex) :
+		_codeCache(ScriptCodeCache::getModeFromEnvironment()),
+		_creationTime(std::chrono::steady_clock::now()), _startupSeconds(0), _compileSeconds(0), _started(false)
 	{
 		ptr<Inanity::Script::V8::State> v8State = new Inanity::Script::V8::State();
 		_scriptsVirtualMachine = v8State;
-		_scriptsEntryPoint = _scriptsVirtualMachine->LoadScript(Platform::FileSystem::GetNativeFileSystem()->LoadFile(SCRIPTS_ENTRY_FILE));
+		_scriptsEntryPoint = loadScript(SCRIPTS_ENTRY_FILE);
 		
 		// register global game objects
 		_logger = NEW(ScriptLogger());
@@ -31,6 +33,8 @@ namespace Firstblood
 		v8State->Register<ScriptInput>();
 		_spatialIndex = NEW(ScriptSpatialIndex(spatialIndex, painter));
 		v8State->Register<ScriptSpatialIndex>();
+		_profiler = NEW(ScriptProfiler());
+		v8State->Register<ScriptProfiler>();
 		_rvoSimulation = rvoSimulation;
 		v8State->Register<RvoSimulation>();
 
@@ -49,6 +53,7 @@ namespace Firstblood
 		_input = nullptr;
 		_camera = nullptr;
 		_spatialIndex = nullptr;
+		_profiler = nullptr;
 		_painter = nullptr;
 		_rvoSimulation = nullptr;
 		_scriptsEntryPoint = nullptr;
@@ -90,6 +95,11 @@ namespace Firstblood
 		return _spatialIndex;
 	}
 
+	ptr<ScriptProfiler> ScriptSystem::getProfiler()
+	{
+		return _profiler;
+	}
+
 	ptr<RvoSimulation> ScriptSystem::getRvoSimulation()
 	{
 		return _rvoSimulation;
@@ -99,18 +109,44 @@ namespace Firstblood
 	{
 		if (_processedScriptSources.find(fileName) == _processedScriptSources.end())
 		{
-			Inanity::String fullName = SCRIPTS_FOLDER + fileName + ".js";
-			ptr<File> scriptFile = Platform::FileSystem::GetNativeFileSystem()->LoadFile(fullName);
 			_processedScriptSources.insert(fileName);
-			_scriptsVirtualMachine->LoadScript(scriptFile)->Run();
+			loadScript(SCRIPTS_FOLDER + fileName + ".js")->Run();
 		}
 	}
 
+	ptr<Inanity::Script::Function> ScriptSystem::loadScript(const Inanity::String& fullName)
+	{
+		SCOPE_PROFILER(ScriptLoad);
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		ptr<Inanity::Script::Function> script = _codeCache.load(_scriptsVirtualMachine, fullName, Platform::FileSystem::GetNativeFileSystem()->LoadFile(fullName));
+		_compileSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		return script;
+	}
+
 	void ScriptSystem::update(float dt)
 	{
-		_time->update();
-		_scriptsEntryPoint->Run();
+		{
+			SCOPE_PROFILER(ScriptTimers);
+			_time->update();
+		}
+		{
+			SCRIPT_CALL_PROFILER(ScriptEntry);
+			_scriptsEntryPoint->Run();
+		}
 		_input->update();
+
+		if (!_started)
+		{
+			_started = true;
+			_startupSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _creationTime).count();
+		}
+	}
+
+	void ScriptSystem::reportStartup(FILE* file) const
+	{
+		// the entry point and the required modules
+		fprintf(file, "scripts: started in %.3f ms, %u files loaded and compiled in %.3f ms, %u from the code cache\n",
+			_startupSeconds * 1000, (unsigned)(_processedScriptSources.size() + 1), _compileSeconds * 1000, (unsigned)_codeCache.getHitsCount());
 	}
 
 	bool ScriptSystem::handleInputEvent(const Inanity::Input::Event& event)
@@ -2,6 +2,8 @@
 #define __FB_SCRIPT_SYSTEM__
 
 #include <unordered_set>
+#include <chrono>
+#include <cstdio>
 #include "inanity/inanity-input.hpp"
 #include "inanity/math/basic.hpp"
 #include "inanity/script/State.hpp"
@@ -12,6 +14,8 @@
 #include "script/camera.hpp"
 #include "script/input.hpp"
 #include "script/spatial.hpp"
+#include "script/profiler.hpp"
+#include "script/code_cache.hpp"
 #include "gamelogic/rvo.hpp"
 #include "Painter.hpp"
 
@@ -28,6 +32,8 @@ namespace Firstblood
 		static ptr<ScriptSystem> getInstance();
 
 		void update(float dt);
+		// script startup time and how much of it went to loading scripts, e.g. for headless runs
+		void reportStartup(FILE* file) const;
 		bool handleInputEvent(const Inanity::Input::Event& event);
 		void setInputState(const Inanity::Input::State* state);
 
@@ -44,6 +50,7 @@ namespace Firstblood
 		ptr<ScriptCamera> getCamera();
 		ptr<ScriptInput> getInput();
 		ptr<ScriptSpatialIndex> getSpatialIndex();
+		ptr<ScriptProfiler> getProfiler();
 		ptr<RvoSimulation> getRvoSimulation();
 		
 		// primitive analogue of python's import statement
@@ -52,9 +59,14 @@ namespace Firstblood
 	public:
 		static ScriptSystem* _instance;
 
+	private:
+		// reads and compiles a script file through the code cache, counted in the startup report
+		ptr<Inanity::Script::Function> loadScript(const Inanity::String& fullName);
+
 	private:
 		// virtual machine
-		ptr<Inanity::Script::State> _scriptsVirtualMachine;
+		ptr<Inanity::Script::V8::State> _scriptsVirtualMachine;
+		ScriptCodeCache _codeCache;
 		ptr<Inanity::Script::Function> _scriptsEntryPoint;
 
 		// global js objects
@@ -64,10 +76,17 @@ namespace Firstblood
 		ptr<ScriptCamera> _camera;
 		ptr<ScriptInput> _input;
 		ptr<ScriptSpatialIndex> _spatialIndex;
+		ptr<ScriptProfiler> _profiler;
 		ptr<RvoSimulation> _rvoSimulation;
 		
 		// processed script files
 		std::unordered_set<Inanity::String> _processedScriptSources;
+
+		// startup report, measured until the end of the first update which requires most of the modules
+		std::chrono::steady_clock::time_point _creationTime;
+		double _startupSeconds;
+		double _compileSeconds;
+		bool _started;
 	};
 
 }
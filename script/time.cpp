@@ -1,4 +1,5 @@
 #include "script/time.hpp"
+#include "script/profiler.hpp"
 
 namespace Firstblood
 {
@@ -62,7 +63,10 @@ namespace Firstblood
 				float shouldBeInvokedAt = timer->lastInvokedAt + timer->timeSpan;
 				if (shouldBeInvokedAt < timeNow)
 				{
-					timer->closure->ApplyWith(nullptr, nullptr, 0);
+					{
+						SCRIPT_CALL_PROFILER(ScriptTimer);
+						timer->closure->ApplyWith(nullptr, nullptr, 0);
+					}
 					if (timer->repeatOnce)
 						timer->markedAsKilled = true;
 					else
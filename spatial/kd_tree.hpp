@@ -24,7 +24,7 @@ namespace Spatial
 
 		virtual ~KdTree()
 		{
-			delete this->_root;
+			delete _arena;
 		}
 
 		virtual void purge()
@@ -48,6 +48,8 @@ namespace Spatial
 				}
 				buildRecursively(this->_root, wrappedObjects, objectsCount);
 			}
+			SPATIAL_COUNT(counterBuilds, 1);
+			SPATIAL_COUNT(counterArenaBytes, _arena->getUsedSize());
 		}
 
 		virtual void build(T** objects, size_t objectsCount)
@@ -65,6 +67,8 @@ namespace Spatial
 				}
 				buildRecursively(this->_root, wrappedObjects, objectsCount);
 			}
+			SPATIAL_COUNT(counterBuilds, 1);
+			SPATIAL_COUNT(counterArenaBytes, _arena->getUsedSize());
 		}
 
 		virtual void optimize() {}
@@ -72,6 +76,7 @@ namespace Spatial
 	private:
 		void buildRecursively(KdTreeNode<T>* node, EntityList<T>* objects, size_t objectsCount)
 		{
+			SPATIAL_COUNT(counterNodesBuilt, 1);
 			node->min.x = FLT_MAX;
 			node->min.y = FLT_MAX;
 			node->max.x = -FLT_MAX;
@@ -1,6 +1,7 @@
 #ifndef __FBE_SPATIAL_QUADTREE_HPP__
 #define __FBE_SPATIAL_QUADTREE_HPP__
 
+#include <iostream>
 #include "spatial/tree_base.hpp"
 
 namespace Spatial
@@ -68,6 +69,8 @@ namespace Spatial
 				vec3 position = object->getPosition();
 				addObjectRecursively(object, radius, position, this->_root, 0);
 			}
+			SPATIAL_COUNT(counterBuilds, 1);
+			SPATIAL_COUNT(counterArenaBytes, _arena->getUsedSize());
 		}
 
 		virtual void build(T** objects, size_t objectsCount)
@@ -79,6 +82,8 @@ namespace Spatial
 				vec3 position = object->getPosition();
 				addObjectRecursively(object, radius, position, this->_root, 0);
 			}
+			SPATIAL_COUNT(counterBuilds, 1);
+			SPATIAL_COUNT(counterArenaBytes, _arena->getUsedSize());
 		}
 
 		// each node's bounding box is shrinked to exactly fit it's content
@@ -115,6 +120,7 @@ namespace Spatial
 						if (currentNode->children[i] == nullptr)
 						{
 							currentNode->children[i] = _arena->alloc<QuadtreeNode<T>>();
+							SPATIAL_COUNT(counterNodesBuilt, 1);
 							initNode(currentNode->children[i], nextLevelSize, x + nodeDesc.x * nextLevelHalfSize, y + nodeDesc.y * nextLevelHalfSize);
 						}
 						deeperNode = currentNode->children[i];
@@ -0,0 +1,108 @@
+#ifndef __FBE_SPATIAL_QUERY_COUNTERS_HPP__
+#define __FBE_SPATIAL_QUERY_COUNTERS_HPP__
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+// define SPATIAL_QUERY_COUNTERS to count the work done by spatial index traversals and builds
+// without it the counting macro expands to nothing, collecting gives zeroes
+#if defined(SPATIAL_QUERY_COUNTERS)
+#define SPATIAL_COUNT( COUNTER, VALUE ) Spatial::addQueryCounter(Spatial::COUNTER, (VALUE))
+#else
+#define SPATIAL_COUNT( COUNTER, VALUE )
+#endif
+
+namespace Spatial
+{
+
+	enum QueryCounter
+	{
+		counterNeighbourQueries,
+		counterRaycasts,
+		counterNodesVisited,
+		counterSubtreesPruned,
+		counterInhabitantsTested,
+		counterHits,
+		counterBuilds,
+		counterNodesBuilt,
+		counterArenaBytes,
+		QUERY_COUNTERS_COUNT
+	};
+
+	struct QueryCounters
+	{
+		uint64_t values[QUERY_COUNTERS_COUNT];
+
+		QueryCounters()
+		{
+			memset(values, 0, sizeof(values));
+		}
+	};
+
+	// running totals of a thread, written only by it, so no read-modify-write is needed
+	struct ThreadQueryCounters
+	{
+		std::atomic<uint64_t> values[QUERY_COUNTERS_COUNT];
+	};
+
+	struct QueryCountersRegistry
+	{
+		std::mutex mutex;
+		std::vector<ThreadQueryCounters*> threads;
+		QueryCounters collectedTotals;
+		QueryCounters frame;
+	};
+
+	inline QueryCountersRegistry& getQueryCountersRegistry()
+	{
+		static QueryCountersRegistry registry;
+		return registry;
+	}
+
+	// counters of exited threads are kept, their totals must not go back
+	inline ThreadQueryCounters* registerThreadQueryCounters()
+	{
+		ThreadQueryCounters* counters = new ThreadQueryCounters();
+		for (size_t i = 0; i < QUERY_COUNTERS_COUNT; ++i)
+			counters->values[i].store(0, std::memory_order_relaxed);
+		QueryCountersRegistry& registry = getQueryCountersRegistry();
+		std::lock_guard<std::mutex> lock(registry.mutex);
+		registry.threads.push_back(counters);
+		return counters;
+	}
+
+	inline void addQueryCounter(QueryCounter counter, uint64_t value)
+	{
+		static thread_local ThreadQueryCounters* counters = registerThreadQueryCounters();
+		std::atomic<uint64_t>& total = counters->values[counter];
+		total.store(total.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+	}
+
+	// counted since the previous call, to be called once per frame
+	inline const QueryCounters& collectQueryCounters()
+	{
+		QueryCountersRegistry& registry = getQueryCountersRegistry();
+		std::lock_guard<std::mutex> lock(registry.mutex);
+		for (size_t i = 0; i < QUERY_COUNTERS_COUNT; ++i)
+		{
+			uint64_t total = 0;
+			for (size_t j = 0; j < registry.threads.size(); ++j)
+				total += registry.threads[j]->values[i].load(std::memory_order_relaxed);
+			registry.frame.values[i] = total - registry.collectedTotals.values[i];
+			registry.collectedTotals.values[i] = total;
+		}
+		return registry.frame;
+	}
+
+	// result of the last collection
+	inline const QueryCounters& getFrameQueryCounters()
+	{
+		return getQueryCountersRegistry().frame;
+	}
+
+}
+
+#endif
@@ -4,6 +4,7 @@
 #include "memory/arena_allocator.hpp"
 #include "geometry/intersections.hpp"
 #include "spatial/interfaces.hpp"
+#include "spatial/query_counters.hpp"
 
 #define GET_NEIGHBOURS_QUERY_MAX_BUFFER_SIZE (size_t)128
 
@@ -43,13 +44,16 @@ namespace Spatial
 
 
 	// base tree class, containing utility Node typedef and implementations of getNearestNeighbours and rayCast queries
-	template<class T, template<class T> class Descendant, template<class T> class Node>
+	template<class T, template<class> class Descendant, template<class> class Node>
 	class TreeBase : public IIndex2D<T>
 	{
 	public:
 		virtual T* raycast(const vec3& origin, const vec3& end, uint32_t mask, float& t, T* skipEntity = nullptr)
 		{
-			return raycastRecursively(origin, end, mask, t, _root, skipEntity);
+			SPATIAL_COUNT(counterRaycasts, 1);
+			T* entity = raycastRecursively(origin, end, mask, t, _root, skipEntity);
+			SPATIAL_COUNT(counterHits, entity != nullptr ? 1 : 0);
+			return entity;
 		}
 
 		virtual size_t getNeighbours(const vec3& point, float distance, uint32_t mask, NearestNeighbor<T>* result, size_t maxResultLength, T* skipEntity = nullptr) const
@@ -58,7 +62,9 @@ namespace Spatial
 				return 0;
 			size_t currentResultLength = 0;
 			float currentMinDistance = distance;
+			SPATIAL_COUNT(counterNeighbourQueries, 1);
 			getNeighboursRecursively(point, currentMinDistance, mask, currentResultLength, maxResultLength, _root, result, skipEntity);
+			SPATIAL_COUNT(counterHits, currentResultLength);
 			return currentResultLength;
 		}
 
@@ -74,9 +80,13 @@ namespace Spatial
 		{
 			vec2 clippedOrigin, clippedEnd;
 			float tmin, tmax;
+			SPATIAL_COUNT(counterNodesVisited, 1);
 			bool intersects = intersectSegmentAABB(vec2(origin.x, origin.y), vec2(end.x, end.y), node->min, node->max, clippedOrigin, clippedEnd, tmin, tmax);
 			if (!intersects)
+			{
+				SPATIAL_COUNT(counterSubtreesPruned, 1);
 				return nullptr;
+			}
 		
 			EntityList<T>* currentInhabitant = node->inhabitants;
 			vec3 i0, i1;
@@ -84,6 +94,7 @@ namespace Spatial
 			T* chosenEntity = nullptr;
 			while (currentInhabitant != nullptr)
 			{
+				SPATIAL_COUNT(counterInhabitantsTested, 1);
 				if ((mask & currentInhabitant->getMask()) && intersectSegmentSphere(origin, end, currentInhabitant->getPosition(), currentInhabitant->getRadius(), i0, i1, tmin, tmax))
 				{
 					T* currentEntity = currentInhabitant->entity;
@@ -122,12 +133,17 @@ namespace Spatial
 		// todo: maybe heap sorting ain't worth it, try to use simple insertion sort instead
 		void getNeighboursRecursively(const vec3& point, float& distance, uint32_t mask, size_t& currentResultLength, size_t maxResultLength, Node<T>* currentNode, NearestNeighbor<T>* heap, T* skipEntity) const
 		{
+			SPATIAL_COUNT(counterNodesVisited, 1);
 			if (!testSphereAABB(vec2(point.x, point.y), distance, currentNode->min, currentNode->max))
+			{
+				SPATIAL_COUNT(counterSubtreesPruned, 1);
 				return;
+			}
 		
 			EntityList<T>* inhabitant = currentNode->inhabitants;
 			while (inhabitant != nullptr)
 			{
+				SPATIAL_COUNT(counterInhabitantsTested, 1);
 				if ((inhabitant->getMask() & mask) && (inhabitant->entity != skipEntity))
 				{
 					vec3 center = inhabitant->getPosition();